@@ -4,8 +4,6 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip> // for std::setw and std::setfill
-#include "QString"
-#include "QCoreApplication"
 #include <iostream>
 
 // Function to compute SHA256 hash of a string using OpenSSL
@@ -37,15 +35,14 @@ std::string sha256(const std::string& str) {
 }
 
 // Constructor loads users upon object creation
-AuthenticationSystem::AuthenticationSystem() {
-    users = loadUsers();
+AuthenticationSystem::AuthenticationSystem(const std::string &usersPath) {
+    users = loadUsers(usersPath);
 }
 
 // Private function to load users and their hashed passwords into a map
-std::unordered_map<std::string, std::string> AuthenticationSystem::loadUsers() {
+std::unordered_map<std::string, std::string> AuthenticationSystem::loadUsers(const std::string &usersPath) {
     std::unordered_map<std::string, std::string> loadedUsers;
-    QString appDirPath = QCoreApplication::applicationDirPath();
-    std::ifstream file(appDirPath.toStdString() + "/users.csv");
+    std::ifstream file(usersPath);
     std::string line, username, hashedPassword;
 
     while (std::getline(file, line)) {
@@ -7,10 +7,10 @@
 
 class AuthenticationSystem {
 public:
-    AuthenticationSystem();
+    AuthenticationSystem(const std::string &usersPath); // CSV of username,SHA-256 of the password
     bool authenticateUser(const std::string &username, const std::string &password);
 private:
-    std::unordered_map<std::string, std::string> loadUsers();
+    std::unordered_map<std::string, std::string> loadUsers(const std::string &usersPath);
     std::unordered_map<std::string, std::string> users;
 };
 
@@ -0,0 +1,213 @@
+#include "CommitLog.h"
+#include "FileHandler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Splits `line` at its first `count` commas; the last field keeps any further commas
+std::vector<std::string> splitFields(const std::string& line, size_t count) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t comma = line.find(',', start);
+        if (comma == std::string::npos) {
+            break;
+        }
+        fields.push_back(line.substr(start, comma - start));
+        start = comma + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+std::string checksumOf(const std::string& lines) {
+    return FileHandler::calculateHash(lines, Digest::Fast);
+}
+
+}
+
+// Constructor
+CommitLog::CommitLog(const std::string& logPath) : logPath(logPath) {
+}
+
+const std::string& CommitLog::path() const {
+    return logPath;
+}
+
+void CommitLog::load() {
+    loaded = true;
+    commits.clear();
+    validLength = 0;
+    indexCurrent = false;
+    std::ifstream logFile(logPath, std::ios::binary);
+    if (!logFile.is_open()) {
+        return;
+    }
+
+    Trace::Span span(Trace::Metadata, "load commit log");
+    try {
+        readBlocks(logFile, 0);
+    } catch (const std::exception&) {
+        // A number cut short; the blocks read so far stand
+    }
+}
+
+void CommitLog::readBlocks(std::istream& logFile, uint64_t offset) {
+    std::string line, block;
+    CommitInfo commit;
+    size_t changeCount = 0;
+    bool inBlock = false;
+    while (std::getline(logFile, line)) {
+        if (logFile.eof()) {
+            break; // No newline: the last line was cut short
+        }
+        offset += line.size() + 1;
+        if (!inBlock) {
+            std::vector<std::string> fields = splitFields(line, 6);
+            if (fields.size() != 7 || fields[0] != "commit") {
+                break;
+            }
+            commit = CommitInfo();
+            commit.version = std::stoi(fields[1]);
+            commit.parent = std::stoi(fields[2]);
+            commit.timeNs = std::stoll(fields[3]);
+            commit.bytesChanged = std::stoull(fields[4]);
+            changeCount = std::stoull(fields[5]);
+            commit.author = fields[6];
+            block = line + "\n";
+            inBlock = true;
+        } else if (commit.changes.size() < changeCount) {
+            std::vector<std::string> fields = splitFields(line, 4);
+            if (fields.size() != 5 || fields[0].size() != 1) {
+                break;
+            }
+            FileChange change;
+            change.kind = static_cast<FileChange::Kind>(fields[0][0]);
+            change.oldDigest = fields[1];
+            change.newDigest = fields[2];
+            change.size = std::stoull(fields[3]);
+            change.path = fields[4];
+            commit.changes.push_back(std::move(change));
+            block += line + "\n";
+        } else {
+            if (line != "end," + std::to_string(commit.version) + "," + checksumOf(block)) {
+                break;
+            }
+            commits[commit.version] = std::move(commit);
+            validLength = offset;
+            inBlock = false;
+        }
+    }
+}
+
+void CommitLog::writeBlock(const CommitInfo& commit, const std::string& blockPath) const {
+    std::ostringstream block;
+    block << "commit," << commit.version << "," << commit.parent << "," << commit.timeNs << "," << commit.bytesChanged
+          << "," << commit.changes.size() << "," << commit.author << "\n";
+    for (const FileChange& change : commit.changes) {
+        block << static_cast<char>(change.kind) << "," << change.oldDigest << "," << change.newDigest << ","
+              << change.size << "," << change.path << "\n";
+    }
+    std::string text = block.str();
+    text += "end," + std::to_string(commit.version) + "," + checksumOf(text) + "\n";
+
+    std::ofstream blockFile(blockPath, std::ios::binary | std::ios::trunc);
+    blockFile << text;
+    blockFile.close();
+    if (!blockFile) {
+        throw std::runtime_error("Failed to write commit log block: " + blockPath);
+    }
+}
+
+// Appending a block twice, when the process stopped before its file was deleted, is
+// harmless: both copies describe the same commit
+void CommitLog::appendFrom(const std::string& blockPath) {
+    std::ifstream blockFile(blockPath, std::ios::binary);
+    if (!blockFile.is_open()) {
+        return;
+    }
+    std::string text((std::istreambuf_iterator<char>(blockFile)), std::istreambuf_iterator<char>());
+    blockFile.close();
+    if (!loaded) {
+        load();
+    }
+
+    // A torn block left by a crash is cut off first, so it cannot hide the new one
+    bool created = !std::filesystem::exists(logPath);
+    if (!created && std::filesystem::file_size(logPath) != validLength) {
+        std::filesystem::resize_file(logPath, validLength);
+    }
+    std::ofstream logFile(logPath, std::ios::binary | std::ios::app);
+    logFile << text;
+    logFile.close();
+    if (!logFile) {
+        throw std::runtime_error("Failed to write commit log: " + logPath);
+    }
+    FileHandler::syncFile(logPath);
+    if (created) {
+        FileHandler::syncDirectory(std::filesystem::path(logPath).parent_path().string());
+    }
+    std::istringstream block(text);
+    readBlocks(block, validLength);
+    indexCurrent = false;
+    std::filesystem::remove(blockPath);
+}
+
+bool CommitLog::find(int version, CommitInfo& commit) {
+    if (!loaded) {
+        load();
+    }
+    auto it = commits.find(version);
+    if (it == commits.end()) {
+        return false;
+    }
+    commit = it->second;
+    return true;
+}
+
+bool CommitLog::contains(int version) {
+    if (!loaded) {
+        load();
+    }
+    return commits.count(version) > 0;
+}
+
+void CommitLog::index() {
+    pathVersions.clear();
+    for (const auto& [version, commit] : commits) {
+        for (const FileChange& change : commit.changes) {
+            pathVersions[change.path].push_back(version); // Versions come in order
+        }
+    }
+    indexCurrent = true;
+}
+
+std::vector<int> CommitLog::history(const std::string& path, int versionCount) {
+    if (!loaded) {
+        load();
+    }
+    if (!indexCurrent) {
+        index();
+    }
+    std::set<int> versions;
+    auto addVersions = [&](const std::vector<int>& changed) {
+        versions.insert(changed.begin(), std::lower_bound(changed.begin(), changed.end(), versionCount));
+    };
+    auto it = pathVersions.find(path);
+    if (it != pathVersions.end()) {
+        addVersions(it->second);
+    }
+    std::string prefix = path.empty() ? "" : path + "/";
+    for (it = pathVersions.lower_bound(prefix); it != pathVersions.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+         ++it) {
+        addVersions(it->second);
+    }
+    return {versions.begin(), versions.end()};
+}
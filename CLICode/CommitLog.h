@@ -0,0 +1,70 @@
+#ifndef COMMIT_LOG_H
+#define COMMIT_LOG_H
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+// A file added, modified or removed by a commit
+struct FileChange {
+    enum Kind : char { Added = 'A', Modified = 'M', Removed = 'D' };
+    Kind kind = Modified;
+    std::string path;      // Relative to the repository
+    std::string oldDigest; // Empty when added
+    std::string newDigest; // Empty when removed
+    uint64_t size = 0;     // Size of the new content, 0 when removed
+};
+
+// What the commit log knows about a version
+struct CommitInfo {
+    int version = 0;
+    int parent = -1;    // Version the commit was made on top of, -1 for the first one
+    int64_t timeNs = 0; // Nanoseconds since the epoch
+    std::string author;
+    uint64_t bytesChanged = 0; // Total size of the added and modified files
+    std::vector<FileChange> changes;
+};
+
+// Append-only log of commits, history/commits.log. Each commit is a block of lines:
+//   commit,<version>,<parent>,<time ns>,<bytes changed>,<change count>,<author>
+//   <kind>,<old digest>,<new digest>,<size>,<path>     (one per changed file)
+//   end,<version>,<XXH64 of the lines above>
+// Paths and authors come last so they may contain commas. A block cut short by a
+// crash fails its checksum and is dropped. Committing again after a rollback reuses
+// version numbers; the latest block of a version is the one that counts, so a block
+// is only added once its commit is durable: it is staged with the commit's files and
+// appended after, again on the next open if the process stopped in between.
+//
+// The log is read once, on first use, into the commits and a per-path index, so
+// the history of a path is found by a binary search.
+class CommitLog {
+public:
+    CommitLog(const std::string& logPath);
+    const std::string& path() const;
+
+    // Write the block of `commit` to a file of its own, such as one staged in a journal
+    void writeBlock(const CommitInfo& commit, const std::string& blockPath) const;
+    // Add the block written to `blockPath` at the end of the log, flush the log and delete
+    // the block's file. Does nothing when there is no such file.
+    void appendFrom(const std::string& blockPath);
+    bool find(int version, CommitInfo& commit); // False if the log has no block for the version
+    bool contains(int version);
+    // Versions below `versionCount` that added, modified or removed `path` (relative),
+    // or a file under it when it is a folder, oldest first
+    std::vector<int> history(const std::string& path, int versionCount);
+private:
+    std::string logPath;
+    bool loaded = false;
+    uint64_t validLength = 0; // Bytes of complete blocks; anything after is a torn block
+    std::map<int, CommitInfo> commits; // Latest block of each version
+    std::map<std::string, std::vector<int>> pathVersions; // Versions changing each path, sorted
+    bool indexCurrent = false;
+
+    void load();
+    void readBlocks(std::istream& logFile, uint64_t offset); // `offset` of the stream's start in the log
+    void index();
+};
+
+#endif // COMMIT_LOG_H
@@ -0,0 +1,81 @@
+#include "CompressionPolicy.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string lowerCase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+}
+
+// Constructor
+CompressionPolicy::CompressionPolicy() {
+    for (const char* extension : {".zip", ".gz", ".tgz", ".bz2", ".xz", ".7z", ".rar", ".zst", ".jpg", ".jpeg", ".png",
+                                  ".gif", ".webp", ".mp3", ".aac", ".ogg", ".flac", ".mp4", ".mkv", ".mov", ".avi",
+                                  ".webm", ".pdf", ".docx", ".xlsx", ".pptx", ".jar", ".apk"}) {
+        rules[extension] = {Store, 0};
+    }
+}
+
+CompressionPolicy::Rule CompressionPolicy::ruleFor(const std::string& filepath) const {
+    auto it = rules.find(lowerCase(std::filesystem::path(filepath).extension().string()));
+    return it != rules.end() ? it->second : defaultRule;
+}
+
+void CompressionPolicy::set(const std::string& extension, Rule rule) {
+    if (rule.codec == Deflate && (rule.level < 1 || rule.level > 9)) {
+        throw std::runtime_error("Compression level must be between 1 and 9.");
+    }
+    if (extension == "*") {
+        defaultRule = rule;
+    } else {
+        rules[lowerCase(extension.empty() || extension[0] == '.' ? extension : "." + extension)] = rule;
+    }
+}
+
+std::string CompressionPolicy::nameOf(Codec codec) {
+    return codec == Store ? "store" : "deflate";
+}
+
+CompressionPolicy::Codec CompressionPolicy::fromName(const std::string& name) {
+    if (name == "store") return Store;
+    if (name == "deflate") return Deflate;
+    throw std::runtime_error("Unknown compression codec: " + name);
+}
+
+// Rows are extension,codec,level and override the built-in rules; a missing file keeps them
+void CompressionPolicy::load(const std::string& policyPath) {
+    std::ifstream policyFile(policyPath);
+    if (!policyFile.is_open()) {
+        return;
+    }
+    std::string line, extension, codec, level;
+    std::getline(policyFile, line); // Skip the header line
+    while (std::getline(policyFile, line)) {
+        std::stringstream linestream(line);
+        std::getline(linestream, extension, ',');
+        std::getline(linestream, codec, ',');
+        std::getline(linestream, level);
+        set(extension, {fromName(codec), std::atoi(level.c_str())});
+    }
+}
+
+void CompressionPolicy::save(const std::string& policyPath) const {
+    std::ofstream policyFile(policyPath);
+    if (!policyFile.is_open()) {
+        throw std::runtime_error("Failed to open compression policy for writing.");
+    }
+    policyFile << "extension,codec,level\n";
+    policyFile << "*," << nameOf(defaultRule.codec) << "," << defaultRule.level << "\n";
+    for (const auto& [extension, rule] : rules) {
+        policyFile << extension << "," << nameOf(rule.codec) << "," << rule.level << "\n";
+    }
+}
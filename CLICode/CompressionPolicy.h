@@ -0,0 +1,35 @@
+#ifndef COMPRESSION_POLICY_H
+#define COMPRESSION_POLICY_H
+
+#include <map>
+#include <string>
+
+// How committed files are compressed, chosen by file extension. Formats that are
+// already compressed (images, video, archives) are stored as they are by default,
+// since deflating them again costs time and saves nothing.
+class CompressionPolicy {
+public:
+    enum Codec {
+        Store,  // Kept uncompressed
+        Deflate // zlib, level 1 (fastest) to 9 (smallest)
+    };
+    struct Rule {
+        Codec codec = Deflate;
+        int level = 6;
+    };
+
+    CompressionPolicy();
+    Rule ruleFor(const std::string& filepath) const;
+    // Rule for files ending in `extension` (".png"), or for all others if it is "*"
+    void set(const std::string& extension, Rule rule);
+    void load(const std::string& policyPath);
+    void save(const std::string& policyPath) const;
+
+    static std::string nameOf(Codec codec);
+    static Codec fromName(const std::string& name);
+private:
+    Rule defaultRule;
+    std::map<std::string, Rule> rules; // By lower-case extension, dot included
+};
+
+#endif // COMPRESSION_POLICY_H
@@ -0,0 +1,153 @@
+#include "Delta.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+const size_t BLOCK_SIZE = 16; // Shortest match worth a copy instruction
+const uint64_t HASH_BASE = 0x100000001b3ULL;
+const char INSERT = 0;
+const char COPY = 1;
+
+// HASH_BASE^(BLOCK_SIZE - 1), the weight of the byte leaving the rolling window
+uint64_t outgoingWeight() {
+    uint64_t weight = 1;
+    for (size_t i = 1; i < BLOCK_SIZE; i++) {
+        weight *= HASH_BASE;
+    }
+    return weight;
+}
+
+uint64_t hashBlock(const unsigned char* p) {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        hash = hash * HASH_BASE + p[i];
+    }
+    return hash;
+}
+
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t readVarint(const std::string& in, size_t& pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            break;
+        }
+        unsigned char byte = static_cast<unsigned char>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed delta.");
+}
+
+}
+
+// Layout: base size, target size, then instructions until the end. An insert is
+// INSERT, a length and the bytes; a copy is COPY, a base offset and a length.
+std::string Delta::encode(const std::string& base, const std::string& target) {
+    std::string delta;
+    appendVarint(delta, base.size());
+    appendVarint(delta, target.size());
+
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(base.data());
+    const unsigned char* t = reinterpret_cast<const unsigned char*>(target.data());
+
+    // Offset of the first base block with each hash
+    std::unordered_map<uint64_t, size_t> blocks;
+    blocks.reserve(base.size() / BLOCK_SIZE + 1);
+    for (size_t offset = 0; offset + BLOCK_SIZE <= base.size(); offset += BLOCK_SIZE) {
+        blocks.emplace(hashBlock(b + offset), offset);
+    }
+
+    const uint64_t weight = outgoingWeight();
+    size_t literalStart = 0; // Target bytes not yet covered by an instruction start here
+    auto flushLiteral = [&](size_t end) {
+        if (end > literalStart) {
+            delta.push_back(INSERT);
+            appendVarint(delta, end - literalStart);
+            delta.append(target, literalStart, end - literalStart);
+        }
+    };
+
+    size_t i = 0;
+    uint64_t hash = target.size() >= BLOCK_SIZE ? hashBlock(t) : 0;
+    while (i + BLOCK_SIZE <= target.size()) {
+        auto match = blocks.find(hash);
+        if (match != blocks.end() && std::memcmp(b + match->second, t + i, BLOCK_SIZE) == 0) {
+            // Extend the match both ways; backwards only over bytes still pending as literal
+            size_t baseStart = match->second, targetStart = i;
+            while (targetStart > literalStart && baseStart > 0 && b[baseStart - 1] == t[targetStart - 1]) {
+                baseStart--;
+                targetStart--;
+            }
+            size_t length = i + BLOCK_SIZE - targetStart;
+            while (targetStart + length < target.size() && baseStart + length < base.size() &&
+                   b[baseStart + length] == t[targetStart + length]) {
+                length++;
+            }
+
+            flushLiteral(targetStart);
+            delta.push_back(COPY);
+            appendVarint(delta, baseStart);
+            appendVarint(delta, length);
+            i = literalStart = targetStart + length;
+            if (i + BLOCK_SIZE <= target.size()) {
+                hash = hashBlock(t + i);
+            }
+            continue;
+        }
+        if (i + BLOCK_SIZE < target.size()) {
+            hash = (hash - t[i] * weight) * HASH_BASE + t[i + BLOCK_SIZE];
+        }
+        i++;
+    }
+    flushLiteral(target.size());
+    return delta;
+}
+
+std::string Delta::apply(const std::string& base, const std::string& delta) {
+    size_t pos = 0;
+    uint64_t baseSize = readVarint(delta, pos);
+    uint64_t targetSize = readVarint(delta, pos);
+    if (baseSize != base.size()) {
+        throw std::runtime_error("Delta does not match its base.");
+    }
+
+    std::string target;
+    target.reserve(targetSize);
+    while (pos < delta.size()) {
+        char op = delta[pos++];
+        if (op == INSERT) {
+            uint64_t length = readVarint(delta, pos);
+            if (length > delta.size() - pos) {
+                throw std::runtime_error("Malformed delta.");
+            }
+            target.append(delta, pos, length);
+            pos += length;
+        } else if (op == COPY) {
+            uint64_t offset = readVarint(delta, pos);
+            uint64_t length = readVarint(delta, pos);
+            if (offset > base.size() || length > base.size() - offset) {
+                throw std::runtime_error("Malformed delta.");
+            }
+            target.append(base, offset, length);
+        } else {
+            throw std::runtime_error("Malformed delta.");
+        }
+    }
+    if (target.size() != targetSize) {
+        throw std::runtime_error("Malformed delta.");
+    }
+    return target;
+}
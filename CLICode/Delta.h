@@ -0,0 +1,16 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <string>
+
+// Binary delta between two versions of a file, in the spirit of git's pack deltas.
+// The encoding is a list of instructions rebuilding the target: copy a range of
+// the base, or insert literal bytes. Matches are found by indexing the base in
+// fixed-size blocks and rolling a hash over the target, so encoding is linear.
+class Delta {
+public:
+    static std::string encode(const std::string& base, const std::string& target);
+    static std::string apply(const std::string& base, const std::string& delta); // Throws on a malformed delta
+};
+
+#endif // DELTA_H
@@ -0,0 +1,363 @@
+#include "Diff.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+
+// Like git, a content with a NUL byte in its first bytes is binary
+const size_t BINARY_PROBE_SIZE = 8000;
+
+// Marks the last line of a content without a line break, so it differs from the same line with one
+const uint64_t NO_NEWLINE_MARK = 0x9e3779b97f4a7c15ULL;
+
+struct BinaryContent {}; // Stops reading a content found to be binary
+
+// Calls `line` with each line of a content and its index. Lines are handed over
+// straight from the chunks, and only copied when they span two of them.
+void forEachLine(const Diff::Source& source, const std::function<void(size_t, std::string_view, bool)>& line,
+                 bool probeBinary) {
+    std::string partial;
+    size_t index = 0;
+    uint64_t offset = 0;
+    source([&](const char* data, size_t size) {
+        if (probeBinary && offset < BINARY_PROBE_SIZE &&
+            std::memchr(data, '\0', std::min<uint64_t>(size, BINARY_PROBE_SIZE - offset))) {
+            throw BinaryContent();
+        }
+        offset += size;
+        const char* end = data + size;
+        while (data < end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            if (!lineEnd) {
+                partial.append(data, end);
+                break;
+            }
+            if (partial.empty()) {
+                line(index++, std::string_view(data, lineEnd - data), true);
+            } else {
+                partial.append(data, lineEnd);
+                line(index++, partial, true);
+                partial.clear();
+            }
+            data = lineEnd + 1;
+        }
+    });
+    if (!partial.empty()) {
+        line(index, partial, false);
+    }
+}
+
+// Myers' O((N+M)D) algorithm in linear space: the middle of a shortest edit script
+// is found by searching from both ends at once, and each half is compared in turn.
+// The search follows the bisection of Neil Fraser's diff-match-patch.
+class Myers {
+public:
+    Myers(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, std::vector<bool>& removed,
+          std::vector<bool>& added)
+        : a(a), b(b), removed(removed), added(added) {
+    }
+
+    void compare(size_t aLow, size_t aHigh, size_t bLow, size_t bHigh) {
+        while (aLow < aHigh && bLow < bHigh && a[aLow] == b[bLow]) {
+            aLow++;
+            bLow++;
+        }
+        while (aLow < aHigh && bLow < bHigh && a[aHigh - 1] == b[bHigh - 1]) {
+            aHigh--;
+            bHigh--;
+        }
+        size_t x, y;
+        if (aLow == aHigh || bLow == bHigh || !split(aLow, aHigh, bLow, bHigh, x, y)) {
+            std::fill(removed.begin() + aLow, removed.begin() + aHigh, true);
+            std::fill(added.begin() + bLow, added.begin() + bHigh, true);
+            return;
+        }
+        compare(aLow, x, bLow, y);
+        compare(x, aHigh, y, bHigh);
+    }
+
+private:
+    const std::vector<uint64_t>& a;
+    const std::vector<uint64_t>& b;
+    std::vector<bool>& removed;
+    std::vector<bool>& added;
+
+    // A point of a shortest edit script between a[aLow, aHigh) and b[bLow, bHigh), which
+    // differ at both ends; false if they have no line in common
+    bool split(size_t aLow, size_t aHigh, size_t bLow, size_t bHigh, size_t& splitX, size_t& splitY) {
+        const ptrdiff_t n = aHigh - aLow, m = bHigh - bLow;
+        const ptrdiff_t maxD = (n + m + 1) / 2, offset = maxD, length = 2 * maxD + 2;
+        std::vector<ptrdiff_t> forward(length, -1), backward(length, -1); // Furthest x on each diagonal
+        forward[offset + 1] = 0;
+        backward[offset + 1] = 0;
+        const ptrdiff_t delta = n - m;
+        const bool front = delta % 2 != 0; // Paths overlap during the forward search when delta is odd
+        ptrdiff_t forwardStart = 0, forwardEnd = 0, backwardStart = 0, backwardEnd = 0; // Diagonals that left the grid
+        for (ptrdiff_t d = 0; d < maxD; d++) {
+            for (ptrdiff_t k = -d + forwardStart; k <= d - forwardEnd; k += 2) {
+                ptrdiff_t x = k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1])
+                                  ? forward[offset + k + 1]
+                                  : forward[offset + k - 1] + 1;
+                ptrdiff_t y = x - k;
+                while (x < n && y < m && a[aLow + x] == b[bLow + y]) {
+                    x++;
+                    y++;
+                }
+                forward[offset + k] = x;
+                if (x > n) {
+                    forwardEnd += 2;
+                } else if (y > m) {
+                    forwardStart += 2;
+                } else if (front) {
+                    ptrdiff_t reverse = offset + delta - k;
+                    if (reverse >= 0 && reverse < length && backward[reverse] != -1 && x >= n - backward[reverse]) {
+                        splitX = aLow + x;
+                        splitY = bLow + y;
+                        return true;
+                    }
+                }
+            }
+            for (ptrdiff_t k = -d + backwardStart; k <= d - backwardEnd; k += 2) {
+                ptrdiff_t x = k == -d || (k != d && backward[offset + k - 1] < backward[offset + k + 1])
+                                  ? backward[offset + k + 1]
+                                  : backward[offset + k - 1] + 1;
+                ptrdiff_t y = x - k;
+                while (x < n && y < m && a[aHigh - x - 1] == b[bHigh - y - 1]) {
+                    x++;
+                    y++;
+                }
+                backward[offset + k] = x;
+                if (x > n) {
+                    backwardEnd += 2;
+                } else if (y > m) {
+                    backwardStart += 2;
+                } else if (!front) {
+                    ptrdiff_t ahead = offset + delta - k;
+                    if (ahead >= 0 && ahead < length && forward[ahead] != -1) {
+                        ptrdiff_t forwardX = forward[ahead];
+                        ptrdiff_t forwardY = offset + forwardX - ahead;
+                        if (forwardX >= n - x) {
+                            splitX = aLow + forwardX;
+                            splitY = bLow + forwardY;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// A run of removed and added lines between unchanged ones
+struct Block {
+    size_t oldBegin, oldEnd, newBegin, newEnd;
+};
+
+struct Content {
+    std::vector<uint64_t> lines; // Hash of each line
+    bool binary = false;
+    bool endsWithNewline = true;
+};
+
+Content scan(const Diff::Source& source) {
+    Content content;
+    std::hash<std::string_view> hash;
+    try {
+        forEachLine(source, [&](size_t, std::string_view line, bool newline) {
+            content.lines.push_back(newline ? hash(line) : hash(line) ^ NO_NEWLINE_MARK);
+            content.endsWithNewline = newline;
+        }, true);
+    } catch (const BinaryContent&) {
+        content.binary = true;
+        content.lines.clear();
+    }
+    return content;
+}
+
+// Copies the lines in `ranges`, sorted and disjoint [begin, end) pairs, out of a content
+std::map<size_t, std::string> readLines(const Diff::Source& source, const std::vector<std::pair<size_t, size_t>>& ranges) {
+    std::map<size_t, std::string> lines;
+    size_t range = 0;
+    forEachLine(source, [&](size_t index, std::string_view line, bool) {
+        while (range < ranges.size() && index >= ranges[range].second) {
+            range++;
+        }
+        if (range < ranges.size() && index >= ranges[range].first) {
+            lines.emplace(index, line);
+        }
+    }, false);
+    return lines;
+}
+
+void addRange(std::vector<std::pair<size_t, size_t>>& ranges, size_t begin, size_t end) {
+    if (begin == end) {
+        return;
+    }
+    if (!ranges.empty() && ranges.back().second >= begin) {
+        ranges.back().second = std::max(ranges.back().second, end);
+    } else {
+        ranges.emplace_back(begin, end);
+    }
+}
+
+std::string rangeOf(size_t start, size_t count) {
+    return count == 1 ? std::to_string(start) : std::to_string(start) + "," + std::to_string(count);
+}
+
+}
+
+void Diff::compareLines(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, std::vector<bool>& removed,
+                        std::vector<bool>& added) {
+    removed.assign(a.size(), false);
+    added.assign(b.size(), false);
+
+    // Lines missing from the other side cannot be common, whatever the edit script
+    std::vector<uint64_t> keptA, keptB;
+    std::vector<size_t> indexA, indexB;
+    {
+        std::unordered_set<uint64_t> linesA(a.begin(), a.end()), linesB(b.begin(), b.end());
+        for (size_t i = 0; i < a.size(); i++) {
+            if (linesB.count(a[i])) {
+                keptA.push_back(a[i]);
+                indexA.push_back(i);
+            } else {
+                removed[i] = true;
+            }
+        }
+        for (size_t j = 0; j < b.size(); j++) {
+            if (linesA.count(b[j])) {
+                keptB.push_back(b[j]);
+                indexB.push_back(j);
+            } else {
+                added[j] = true;
+            }
+        }
+    }
+
+    std::vector<bool> keptRemoved(keptA.size(), false), keptAdded(keptB.size(), false);
+    Myers(keptA, keptB, keptRemoved, keptAdded).compare(0, keptA.size(), 0, keptB.size());
+    for (size_t i = 0; i < keptA.size(); i++) {
+        if (keptRemoved[i]) removed[indexA[i]] = true;
+    }
+    for (size_t j = 0; j < keptB.size(); j++) {
+        if (keptAdded[j]) added[indexB[j]] = true;
+    }
+}
+
+FileDiff Diff::compare(const std::string& path, FileChange::Kind kind, const Source& oldContent,
+                       const Source& newContent, size_t context) {
+    Trace::Span span(Trace::Compare, "diff", path);
+    FileDiff diff;
+    diff.path = path;
+    diff.kind = kind;
+    Content before = scan(oldContent);
+    Content after = scan(newContent);
+    if (before.binary || after.binary) {
+        diff.binary = true;
+        return diff;
+    }
+
+    std::vector<bool> removed, added;
+    compareLines(before.lines, after.lines, removed, added);
+    std::vector<Block> blocks;
+    for (size_t i = 0, j = 0; i < removed.size() || j < added.size();) {
+        if (i < removed.size() && j < added.size() && !removed[i] && !added[j]) {
+            i++;
+            j++;
+            continue;
+        }
+        Block block{i, i, j, j};
+        while (block.oldEnd < removed.size() && removed[block.oldEnd]) block.oldEnd++;
+        while (block.newEnd < added.size() && added[block.newEnd]) block.newEnd++;
+        blocks.push_back(block);
+        i = block.oldEnd;
+        j = block.newEnd;
+    }
+    if (blocks.empty()) {
+        return diff;
+    }
+
+    // Blocks closer than twice the context share a hunk. Unchanged lines are the same
+    // on both sides, so context is taken from the old content.
+    std::vector<std::pair<size_t, size_t>> hunkBlocks; // First and last block of each hunk
+    for (size_t k = 0; k < blocks.size(); k++) {
+        if (!hunkBlocks.empty() && blocks[k].oldBegin - blocks[hunkBlocks.back().second].oldEnd <= 2 * context) {
+            hunkBlocks.back().second = k;
+        } else {
+            hunkBlocks.emplace_back(k, k);
+        }
+    }
+    std::vector<std::pair<size_t, size_t>> oldRanges, newRanges;
+    for (const auto& [first, last] : hunkBlocks) {
+        size_t begin = blocks[first].oldBegin - std::min(context, blocks[first].oldBegin);
+        addRange(oldRanges, begin, std::min(removed.size(), blocks[last].oldEnd + context));
+        for (size_t k = first; k <= last; k++) {
+            addRange(newRanges, blocks[k].newBegin, blocks[k].newEnd);
+        }
+    }
+    std::map<size_t, std::string> oldLines = readLines(oldContent, oldRanges);
+    std::map<size_t, std::string> newLines = readLines(newContent, newRanges);
+
+    auto oldLine = [&](char kind, size_t i) {
+        return DiffLine{kind, oldLines[i], i + 1 < removed.size() || before.endsWithNewline};
+    };
+    for (const auto& [first, last] : hunkBlocks) {
+        DiffHunk hunk;
+        size_t leading = std::min(context, blocks[first].oldBegin);
+        size_t i = blocks[first].oldBegin - leading, j = blocks[first].newBegin - leading;
+        size_t oldEnd = std::min(removed.size(), blocks[last].oldEnd + context);
+        hunk.oldStart = i;
+        hunk.newStart = j;
+        for (size_t k = first; k <= last; k++) {
+            for (; i < blocks[k].oldBegin; i++, j++) {
+                hunk.lines.push_back(oldLine(' ', i));
+            }
+            for (; i < blocks[k].oldEnd; i++) {
+                hunk.lines.push_back(oldLine('-', i));
+            }
+            for (; j < blocks[k].newEnd; j++) {
+                hunk.lines.push_back({'+', newLines[j], j + 1 < added.size() || after.endsWithNewline});
+            }
+        }
+        for (; i < oldEnd; i++, j++) {
+            hunk.lines.push_back(oldLine(' ', i));
+        }
+        hunk.oldCount = i - hunk.oldStart;
+        hunk.newCount = j - hunk.newStart;
+        // Numbered from 1; an empty range names the line before it
+        if (hunk.oldCount > 0) hunk.oldStart++;
+        if (hunk.newCount > 0) hunk.newStart++;
+        diff.hunks.push_back(std::move(hunk));
+    }
+    return diff;
+}
+
+std::string Diff::unified(const FileDiff& diff) {
+    std::ostringstream text;
+    text << "--- " << (diff.kind == FileChange::Added ? "/dev/null" : "a/" + diff.path) << "\n";
+    text << "+++ " << (diff.kind == FileChange::Removed ? "/dev/null" : "b/" + diff.path) << "\n";
+    if (diff.binary) {
+        text << "Binary files differ\n";
+    }
+    for (const DiffHunk& hunk : diff.hunks) {
+        text << "@@ -" << rangeOf(hunk.oldStart, hunk.oldCount) << " +" << rangeOf(hunk.newStart, hunk.newCount)
+             << " @@\n";
+        for (const DiffLine& line : hunk.lines) {
+            text << line.kind << line.text << "\n";
+            if (!line.newline) {
+                text << "\\ No newline at end of file\n";
+            }
+        }
+    }
+    return text.str();
+}
+
+Diff::Source Diff::empty() {
+    return [](const std::function<void(const char*, size_t)>&) {};
+}
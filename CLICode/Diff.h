@@ -0,0 +1,54 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include "CommitLog.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A line of a hunk: ' ' unchanged, '-' removed or '+' added
+struct DiffLine {
+    char kind = ' ';
+    std::string text;     // Without its line break
+    bool newline = true;  // False for the last line of a file that does not end with one
+};
+
+// Changed lines with their context, numbered from 1 as in a unified diff
+struct DiffHunk {
+    size_t oldStart = 0;
+    size_t oldCount = 0;
+    size_t newStart = 0;
+    size_t newCount = 0;
+    std::vector<DiffLine> lines;
+};
+
+// How a file differs between two versions
+struct FileDiff {
+    std::string path; // Relative to the repository
+    FileChange::Kind kind = FileChange::Modified;
+    bool binary = false; // Binary contents are not compared line by line
+    std::vector<DiffHunk> hunks;
+};
+
+// Line-level comparison of two contents, read as streams of chunks so neither is held
+// in memory: the first pass keeps one hash per line, the second only the lines that
+// end up in hunks. Lines found on one side only are set aside before Myers' algorithm
+// (in its linear space form) matches the rest, so rewritten files are cheap to compare.
+class Diff {
+public:
+    // Calls its sink with consecutive chunks of a content, like FileHandler::streamFile
+    using Source = std::function<void(const std::function<void(const char*, size_t)>&)>;
+
+    // Hunks of the changes from `oldContent` to `newContent`, with `context` unchanged lines around them
+    static FileDiff compare(const std::string& path, FileChange::Kind kind, const Source& oldContent,
+                            const Source& newContent, size_t context = 3);
+    // Flags, for each line of `a` and `b`, whether it is missing from a shortest edit script's common lines
+    static void compareLines(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+                             std::vector<bool>& removed, std::vector<bool>& added);
+    // The diff as text, in the unified format of diff -u and git
+    static std::string unified(const FileDiff& diff);
+    static Source empty(); // Content of the missing side of an added or removed file
+};
+
+#endif // DIFF_H
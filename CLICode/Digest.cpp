@@ -0,0 +1,227 @@
+#include "Digest.h"
+#include "openssl/evp.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string toHex(const unsigned char* bytes, size_t length) {
+    std::stringstream ss;
+    for (size_t i = 0; i < length; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(bytes[i]);
+    }
+    return ss.str();
+}
+
+// SHA-256 through OpenSSL, which picks the SHA extensions of the CPU when present
+class Sha256Digest : public Digest {
+public:
+    Sha256Digest() : context(EVP_MD_CTX_new()) {
+        if (!context || EVP_DigestInit_ex(context, EVP_sha256(), NULL) != 1) {
+            EVP_MD_CTX_free(context);
+            throw std::runtime_error("Failed to initialize hash computation");
+        }
+    }
+    ~Sha256Digest() override { EVP_MD_CTX_free(context); }
+    Sha256Digest(const Sha256Digest&) = delete;
+    Sha256Digest& operator=(const Sha256Digest&) = delete;
+
+    void update(const char* data, size_t size) override {
+        if (EVP_DigestUpdate(context, data, size) != 1) {
+            throw std::runtime_error("Hash computation failed");
+        }
+    }
+
+    std::string hexDigest() override {
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int lengthOfHash = 0;
+        if (EVP_DigestFinal_ex(context, hash, &lengthOfHash) != 1) {
+            throw std::runtime_error("Hash computation failed");
+        }
+        return toHex(hash, lengthOfHash);
+    }
+
+private:
+    EVP_MD_CTX* context;
+};
+
+// Streaming XXH64 (seed 0), bit-compatible with the reference implementation.
+// Input is consumed in 32-byte stripes by four independent lanes, which keeps
+// the multipliers of a core busy without any platform specific intrinsics.
+class Xxh64Digest : public Digest {
+public:
+    void update(const char* data, size_t size) override {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        totalLength += size;
+
+        if (bufferSize + size < STRIPE) {
+            std::memcpy(buffer + bufferSize, p, size);
+            bufferSize += size;
+            return;
+        }
+        if (bufferSize > 0) {
+            size_t fill = STRIPE - bufferSize;
+            std::memcpy(buffer + bufferSize, p, fill);
+            consumeStripe(buffer);
+            p += fill;
+            bufferSize = 0;
+        }
+        while (end - p >= static_cast<std::ptrdiff_t>(STRIPE)) {
+            consumeStripe(p);
+            p += STRIPE;
+        }
+        bufferSize = static_cast<size_t>(end - p);
+        std::memcpy(buffer, p, bufferSize);
+    }
+
+    std::string hexDigest() override {
+        uint64_t h;
+        if (totalLength >= STRIPE) {
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = mergeRound(h, v1);
+            h = mergeRound(h, v2);
+            h = mergeRound(h, v3);
+            h = mergeRound(h, v4);
+        } else {
+            h = PRIME5;
+        }
+        h += totalLength;
+
+        const unsigned char* p = buffer;
+        size_t remaining = bufferSize;
+        while (remaining >= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+            p += 8;
+            remaining -= 8;
+        }
+        if (remaining >= 4) {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+            remaining -= 4;
+        }
+        while (remaining > 0) {
+            h ^= (*p) * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+            p++;
+            remaining--;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+
+        unsigned char bytes[8];
+        for (int i = 0; i < 8; i++) {
+            bytes[i] = static_cast<unsigned char>(h >> (56 - 8 * i));
+        }
+        return toHex(bytes, sizeof(bytes));
+    }
+
+private:
+    static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+    static const size_t STRIPE = 32;
+
+    uint64_t v1 = PRIME1 + PRIME2;
+    uint64_t v2 = PRIME2;
+    uint64_t v3 = 0;
+    uint64_t v4 = 0 - PRIME1;
+    uint64_t totalLength = 0;
+    unsigned char buffer[STRIPE];
+    size_t bufferSize = 0;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    // Little-endian loads; memcpy compiles to a single unaligned load
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+    static uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap32(value);
+#endif
+        return value;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+    }
+    static uint64_t mergeRound(uint64_t acc, uint64_t value) {
+        acc ^= round(0, value);
+        return acc * PRIME1 + PRIME4;
+    }
+
+    void consumeStripe(const unsigned char* p) {
+        v1 = round(v1, read64(p));
+        v2 = round(v2, read64(p + 8));
+        v3 = round(v3, read64(p + 16));
+        v4 = round(v4, read64(p + 24));
+    }
+};
+
+// std::hash of the whole content. It cannot be updated incrementally, so the
+// content is buffered; this exists only to verify hashes from older repositories.
+class LegacyDigest : public Digest {
+public:
+    void update(const char* data, size_t size) override { content.append(data, size); }
+    std::string hexDigest() override { return std::to_string(std::hash<std::string>()(content)); }
+private:
+    std::string content;
+};
+
+}
+
+std::unique_ptr<Digest> Digest::create(Algorithm algorithm) {
+    switch (algorithm) {
+    case Fast:
+        return std::make_unique<Xxh64Digest>();
+    case Strong:
+        return std::make_unique<Sha256Digest>();
+    case Legacy:
+        return std::make_unique<LegacyDigest>();
+    }
+    throw std::runtime_error("Unknown digest algorithm");
+}
+
+// Ids are versioned so that a change of output format gets a new id
+std::string Digest::idOf(Algorithm algorithm) {
+    switch (algorithm) {
+    case Fast:
+        return "xxh64-1";
+    case Strong:
+        return "sha256-1";
+    case Legacy:
+        return "std-hash";
+    }
+    throw std::runtime_error("Unknown digest algorithm");
+}
+
+Digest::Algorithm Digest::fromId(const std::string& id) {
+    for (Algorithm algorithm : {Fast, Strong, Legacy}) {
+        if (idOf(algorithm) == id) {
+            return algorithm;
+        }
+    }
+    throw std::runtime_error("Unknown digest algorithm: " + id);
+}
@@ -0,0 +1,28 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Incremental content digest with interchangeable algorithms.
+// Every algorithm has a stable, versioned id that is stored with the repository,
+// so recorded hashes are only ever compared with hashes of the same algorithm.
+class Digest {
+public:
+    enum Algorithm {
+        Fast,   // XXH64: non-cryptographic, several GB/s per core, used for change detection
+        Strong, // SHA-256: collision resistant, used to name stored objects
+        Legacy  // std::hash<std::string>: only to read hashes written by older versions
+    };
+
+    static std::unique_ptr<Digest> create(Algorithm algorithm);
+    static std::string idOf(Algorithm algorithm);
+    static Algorithm fromId(const std::string& id);
+
+    virtual ~Digest() = default;
+    virtual void update(const char* data, size_t size) = 0;
+    virtual std::string hexDigest() = 0;
+};
+
+#endif // DIGEST_H
@@ -1,13 +1,35 @@
 #include "FileHandler.h"
+#include "Trace.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files are hashed through a buffer of this size, so memory use does not depend on file size
+const size_t HASH_BUFFER_SIZE = 64 * 1024;
+// Each of the two buffers of streamFile; large enough to make the hand-over between threads cheap
+const size_t STREAM_BUFFER_SIZE = 1024 * 1024;
+
+}
 
 // Reads the entire content of a file
 std::string FileHandler::readFile(const std::string& filename) {
+    Trace::Span span(Trace::Read, "read file", filename);
     std::ifstream file(filename);
-    std::cerr << filename << std::endl;
     if (!file.is_open()) {
         std::cerr << "Failed to open file: " << filename << std::endl;
         throw std::runtime_error("Could not open file: " + filename);
@@ -29,10 +51,198 @@ void FileHandler::writeFile(const std::string& filename, const std::string& cont
     file.close();
 }
 
-std::string FileHandler::calculateHash(const std::string& content) {
-    std::hash<std::string> hasher;
-    auto hashed = hasher(content); // This produces a size_t hash value
-    std::stringstream ss;
-    ss << hashed;
-    return ss.str();
+std::string FileHandler::calculateHash(const std::string& content, Digest::Algorithm algorithm) {
+    std::unique_ptr<Digest> hasher = Digest::create(algorithm);
+    hasher->update(content.data(), content.size());
+    return hasher->hexDigest();
+}
+
+// Hashes a file chunk by chunk, giving the same digest as calculateHash on its content
+std::string FileHandler::hashFile(const std::string& filename, Digest::Algorithm algorithm) {
+    Trace::Span span(Trace::Hash, "hash file", filename);
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    std::unique_ptr<Digest> hasher = Digest::create(algorithm);
+    std::vector<char> buffer(HASH_BUFFER_SIZE);
+    uint64_t bytes = 0;
+    while (true) {
+        {
+            Trace::Span read(Trace::Read, nullptr); // Too many to trace one by one
+            if (!file.read(buffer.data(), buffer.size()) && file.gcount() == 0) {
+                break;
+            }
+        }
+        hasher->update(buffer.data(), static_cast<size_t>(file.gcount()));
+        bytes += static_cast<uint64_t>(file.gcount());
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Could not read file: " + filename);
+    }
+    Trace::count(Trace::FilesHashed);
+    Trace::count(Trace::BytesHashed, bytes);
+    return hasher->hexDigest();
+}
+
+// The first buffer is read on the calling thread, and a file that fits in it goes straight
+// to `consumer`. Past it, double buffering: a reader thread fills one buffer while
+// `consumer` processes the other. An empty buffer marks the end of the file.
+void FileHandler::streamFile(const std::string& filename, const std::function<void(const char*, size_t)>& consumer) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    // Callers run on the pool's threads, so each thread keeps its buffers from one file to the
+    // next; a consumer streaming another file meanwhile gets buffers of its own
+    thread_local std::vector<char> threadBuffers[2];
+    thread_local bool threadBuffersInUse = false;
+    struct Lease {
+        bool& inUse;
+        bool taken;
+        ~Lease() { if (taken) inUse = false; }
+    } lease{threadBuffersInUse, !threadBuffersInUse};
+    std::vector<char> ownBuffers[2];
+    std::vector<char>* buffers = lease.taken ? threadBuffers : ownBuffers;
+    lease.inUse = true;
+
+    buffers[0].resize(STREAM_BUFFER_SIZE);
+    {
+        Trace::Span span(Trace::Read, "read");
+        file.read(buffers[0].data(), buffers[0].size());
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Could not read file: " + filename);
+    }
+    size_t firstSize = static_cast<size_t>(file.gcount());
+    if (firstSize < buffers[0].size() || file.peek() == std::ifstream::traits_type::eof()) {
+        if (firstSize > 0) {
+            consumer(buffers[0].data(), firstSize);
+        }
+        return;
+    }
+
+    buffers[1].resize(STREAM_BUFFER_SIZE);
+    size_t sizes[2] = {firstSize, 0};
+    bool filled[2] = {true, false};
+    bool stopping = false;
+    std::exception_ptr readFailure;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::thread reader([&]() {
+        for (int slot = 1;; slot ^= 1) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !filled[slot] || stopping; });
+                if (stopping) return;
+            }
+            {
+                Trace::Span span(Trace::Read, "read");
+                file.read(buffers[slot].data(), buffers[slot].size());
+            }
+            size_t bytesRead = static_cast<size_t>(file.gcount());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (file.bad()) {
+                    readFailure = std::make_exception_ptr(std::runtime_error("Could not read file: " + filename));
+                    bytesRead = 0;
+                }
+                sizes[slot] = bytesRead;
+                filled[slot] = true;
+            }
+            changed.notify_all();
+            if (bytesRead == 0) return;
+        }
+    });
+
+    try {
+        for (int slot = 0;; slot ^= 1) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return filled[slot]; });
+            }
+            if (sizes[slot] == 0) break;
+            consumer(buffers[slot].data(), sizes[slot]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                filled[slot] = false;
+            }
+            changed.notify_all();
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        reader.join();
+        throw;
+    }
+    reader.join();
+    if (readFailure) {
+        std::rethrow_exception(readFailure);
+    }
+}
+
+bool FileHandler::statFile(const std::string& filename, FileStat& stat) {
+    const int64_t NS_PER_SECOND = 1000000000;
+    Trace::Span span(Trace::Stat, nullptr);
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(filename.c_str(), &info) != 0 || !(info.st_mode & _S_IFREG)) {
+        return false;
+    }
+    stat.mtimeNs = static_cast<int64_t>(info.st_mtime) * NS_PER_SECOND;
+    stat.ctimeNs = static_cast<int64_t>(info.st_ctime) * NS_PER_SECOND;
+#else
+    struct stat info;
+    if (::stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+#ifdef __APPLE__
+    stat.mtimeNs = static_cast<int64_t>(info.st_mtimespec.tv_sec) * NS_PER_SECOND + info.st_mtimespec.tv_nsec;
+    stat.ctimeNs = static_cast<int64_t>(info.st_ctimespec.tv_sec) * NS_PER_SECOND + info.st_ctimespec.tv_nsec;
+#else
+    stat.mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * NS_PER_SECOND + info.st_mtim.tv_nsec;
+    stat.ctimeNs = static_cast<int64_t>(info.st_ctim.tv_sec) * NS_PER_SECOND + info.st_ctim.tv_nsec;
+#endif
+#endif
+    stat.size = static_cast<uint64_t>(info.st_size);
+    stat.inode = static_cast<uint64_t>(info.st_ino);
+    return true;
+}
+
+void FileHandler::syncFile(const std::string& filename) {
+    Trace::Span span(Trace::Write, "sync", filename);
+#ifdef _WIN32
+    int fd = _open(filename.c_str(), _O_RDWR | _O_BINARY);
+    bool synced = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0) _close(fd);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+#endif
+    if (!synced) {
+        throw std::runtime_error("Could not flush file to disk: " + filename);
+    }
+}
+
+// Windows does not let folders be flushed; NTFS journals its renames itself
+void FileHandler::syncDirectory(const std::string& foldername) {
+#ifndef _WIN32
+    Trace::Span span(Trace::Write, "sync", foldername);
+    int fd = ::open(foldername.c_str(), O_RDONLY | O_DIRECTORY);
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!synced) {
+        throw std::runtime_error("Could not flush folder to disk: " + foldername);
+    }
+#else
+    (void)foldername;
+#endif
 }
@@ -2,12 +2,32 @@
 #define FILE_HANDLER_H
 
 #include <string>
+#include <cstdint>
+#include <functional>
+#include "Digest.h"
+
+// Metadata that changes whenever a file's content may have changed
+struct FileStat {
+    uint64_t size = 0;
+    int64_t mtimeNs = 0; // Modification time, nanoseconds since the epoch
+    int64_t ctimeNs = 0; // Status change time (creation time on Windows)
+    uint64_t inode = 0;  // Always 0 on Windows
+};
 
 class FileHandler {
 public:
     static std::string readFile(const std::string& filename);
     static void writeFile(const std::string& filename, const std::string& content);
-    static std::string calculateHash(const std::string& content);
+    static std::string calculateHash(const std::string& content, Digest::Algorithm algorithm = Digest::Strong);
+    // Hashes a file by streaming it through a fixed-size buffer, without loading it into memory
+    static std::string hashFile(const std::string& filename, Digest::Algorithm algorithm = Digest::Strong);
+    // Passes a file to `consumer` chunk by chunk; past the first chunk, the next one is read while the current one is consumed
+    static void streamFile(const std::string& filename, const std::function<void(const char*, size_t)>& consumer);
+    // Fills `stat` for a regular file, returns false if it cannot be stat'ed
+    static bool statFile(const std::string& filename, FileStat& stat);
+    // Wait until a file's content, or a folder's entries (new and renamed files), are on disk
+    static void syncFile(const std::string& filename);
+    static void syncDirectory(const std::string& foldername);
 };
 
 #endif // FILE_HANDLER_H
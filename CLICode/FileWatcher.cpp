@@ -0,0 +1,166 @@
+#include "FileWatcher.h"
+#include "Repository.h"
+#include <filesystem>
+#include <iostream>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                            IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+const size_t EVENT_BUFFER_SIZE = 64 * 1024;
+
+}
+#endif
+
+// Constructor, starts watching right away; folders are registered on the watcher's thread
+FileWatcher::FileWatcher(const std::string& rootPath, Listener listener)
+    : root(rootPath), listener(std::move(listener)) {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0 || stopFd < 0) {
+        std::cerr << "File watching unavailable, refreshing rescans " << root << std::endl;
+        return;
+    }
+    watching = true;
+    thread = std::thread(&FileWatcher::run, this);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0) {
+            std::cerr << "Could not stop the file watcher" << std::endl;
+        }
+        thread.join();
+    }
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (stopFd >= 0) close(stopFd);
+#endif
+}
+
+bool FileWatcher::isWatching() const {
+    return watching;
+}
+
+const std::string& FileWatcher::rootPath() const {
+    return root;
+}
+
+std::vector<std::string> FileWatcher::takeChanges(bool& rescan) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rescan = !watching || incomplete || rescanNeeded;
+    rescanNeeded = false;
+    std::vector<std::string> paths(changed.begin(), changed.end());
+    changed.clear();
+    return paths;
+}
+
+void FileWatcher::requestRescan() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rescanNeeded = true;
+}
+
+#ifdef __linux__
+// The repository's metadata changes on every operation and says nothing about tracked files
+bool FileWatcher::isExcluded(const std::string& path) const {
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    return parent == std::filesystem::path(root) &&
+           Repository::isReservedName(std::filesystem::path(path).filename().string());
+}
+
+// Register `folder` and every folder below it
+void FileWatcher::watchTree(const std::string& folder) {
+    std::error_code error;
+    std::vector<std::string> pending = {folder};
+    while (!pending.empty()) {
+        std::string path = pending.back();
+        pending.pop_back();
+        int descriptor = inotify_add_watch(inotifyFd, path.c_str(), WATCH_MASK);
+        if (descriptor < 0) {
+            if (errno == ENOSPC) {
+                std::cerr << "Too many folders to watch under " << root
+                          << ", refreshing rescans; raise fs.inotify.max_user_watches to avoid it" << std::endl;
+                std::lock_guard<std::mutex> lock(mutex);
+                incomplete = true;
+            }
+            continue; // Not a folder, or gone already
+        }
+        folders[descriptor] = path;
+        for (std::filesystem::directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+            if (it->is_directory(error) && !it->is_symlink(error) && !isExcluded(it->path().string())) {
+                pending.push_back(it->path().string());
+            }
+        }
+    }
+}
+
+void FileWatcher::markChanged(const std::string& path, bool rescan) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rescan) {
+        rescanNeeded = true;
+    } else {
+        changed.insert(path);
+    }
+}
+
+void FileWatcher::run() {
+    watchTree(root);
+    // Anything that changed while folders were being registered may have been missed
+    markChanged("", true);
+
+    std::vector<char> buffer(EVENT_BUFFER_SIZE);
+    pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    while (true) {
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (descriptors[1].revents) {
+            break;
+        }
+        bool notify = false;
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer.data(), buffer.size())) > 0) {
+            for (char* p = buffer.data(); p < buffer.data() + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    markChanged("", true);
+                    notify = true;
+                    continue;
+                }
+                auto folder = folders.find(event->wd);
+                if (folder == folders.end()) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    folders.erase(folder); // The folder is gone or was moved away
+                    continue;
+                }
+                std::string path = event->len > 0 ? folder->second + "/" + event->name : folder->second;
+                if (isExcluded(path)) {
+                    continue;
+                }
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    watchTree(path); // Files written into it before it was registered are found by walking it
+                }
+                markChanged(path, false);
+                notify = true; // Only for changes a refresh has to look at, not its own metadata writes
+            }
+        }
+        if (notify && listener) {
+            listener();
+        }
+    }
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Paths changed under a folder since they were last taken, collected by a thread
+// from the kernel's notifications (inotify on Linux), so a refresh only has to look
+// at what changed. Every folder is registered, new ones as they appear, except the
+// repository's own metadata. When notifications are lost (queue overflow, watch
+// limit) or not available on the platform, the next take asks for a full rescan.
+class FileWatcher {
+public:
+    using Listener = std::function<void()>;
+
+    // `listener` is called from the watcher's thread whenever new changes arrive
+    FileWatcher(const std::string& rootPath, Listener listener = nullptr);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool isWatching() const;
+    const std::string& rootPath() const;
+    // Changed files and folders since the last take. `rescan` is set when changes
+    // may be missing, starting with the first take, and everything must be checked.
+    std::vector<std::string> takeChanges(bool& rescan);
+    void requestRescan(); // Taken changes could not be applied
+private:
+    std::string root;
+    Listener listener;
+    std::mutex mutex; // Guards changed and rescanNeeded
+    std::set<std::string> changed;
+    bool rescanNeeded = true;
+    bool incomplete = false; // Some folders could not be registered, so every take rescans
+    bool watching = false;
+#ifdef __linux__
+    int inotifyFd = -1;
+    int stopFd = -1; // eventfd, wakes the thread up to stop
+    std::map<int, std::string> folders; // By watch descriptor, only used by the thread
+    std::thread thread;
+
+    void watchTree(const std::string& folder);
+    bool isExcluded(const std::string& path) const;
+    void run();
+    void markChanged(const std::string& path, bool rescan);
+#endif
+};
+
+#endif // FILE_WATCHER_H
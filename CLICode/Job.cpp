@@ -0,0 +1,49 @@
+#include "Job.h"
+#include <exception>
+
+// Constructor, starts the work right away
+Job::Job(std::function<void(Progress&)> work, Listener listener) {
+    state.setListener(std::move(listener.progress));
+    thread = std::thread([this, work = std::move(work), finished = std::move(listener.finished)]() {
+        std::string error;
+        bool cancelled = false;
+        try {
+            work(state);
+        } catch (const OperationCancelled& e) {
+            error = e.what();
+            cancelled = true;
+        } catch (const std::exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "Unknown error.";
+        }
+        state.report();
+        running = false;
+        if (finished) {
+            finished(error, cancelled);
+        }
+    });
+}
+
+Job::~Job() {
+    cancel();
+    wait();
+}
+
+void Job::cancel() {
+    state.cancel();
+}
+
+bool Job::isRunning() const {
+    return running;
+}
+
+Progress::Snapshot Job::progress() const {
+    return state.snapshot();
+}
+
+void Job::wait() {
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+        thread.join();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include "Progress.h"
+
+// Repository operation running on a thread of its own, so a caller such as the
+// GUI stays responsive. The work reports to a Progress and checks it for
+// cancellation; the listener is called from the job's thread (and from the pool
+// for progress), so a GUI has to hand the calls over to its own thread.
+class Job {
+public:
+    struct Listener {
+        Progress::Listener progress;
+        // Called once when the work returns: empty error on success
+        std::function<void(const std::string& error, bool cancelled)> finished;
+    };
+
+    Job(std::function<void(Progress&)> work, Listener listener);
+    ~Job(); // Cancels the work and waits for it
+    Job(const Job&) = delete;
+    Job& operator=(const Job&) = delete;
+
+    void cancel(); // The work stops at its next check, leaving the repository consistent
+    bool isRunning() const;
+    Progress::Snapshot progress() const;
+    void wait();
+private:
+    Progress state;
+    std::atomic<bool> running{true};
+    std::thread thread; // Last, so it starts once everything else is constructed
+};
+
+#endif // JOB_H
@@ -0,0 +1,194 @@
+#include "Journal.h"
+#include "Digest.h"
+#include "FileHandler.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const std::string JOURNAL_HEADER = "journal,1";
+
+// Checksum of the journal lines before its last one
+std::string checksumOf(const std::string& lines) {
+    return FileHandler::calculateHash(lines, Digest::Fast);
+}
+
+// Flush every path, in parallel when a pool is given
+void syncAll(const std::vector<std::string>& paths, bool directories, ThreadPool* pool) {
+    if (!pool || paths.size() < 2) {
+        for (const std::string& path : paths) {
+            directories ? FileHandler::syncDirectory(path) : FileHandler::syncFile(path);
+        }
+        return;
+    }
+    std::vector<std::future<void>> syncs;
+    for (const std::string& path : paths) {
+        syncs.push_back(pool->submit([path, directories]() {
+            directories ? FileHandler::syncDirectory(path) : FileHandler::syncFile(path);
+        }));
+    }
+    std::exception_ptr failure;
+    for (auto& sync : syncs) {
+        try {
+            pool->wait(sync);
+        } catch (...) {
+            if (!failure) failure = std::current_exception();
+        }
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+// Folders holding `paths`, with their ancestors up to `root`: a folder the transaction
+// created, such as a new fan-out folder of the object store, is only durable once the
+// folder holding it is flushed too
+std::vector<std::string> parentsOf(const std::vector<std::string>& paths, const std::string& root) {
+    std::filesystem::path top = std::filesystem::path(root).lexically_normal();
+    auto below = [&top](const std::filesystem::path& folder) {
+        std::filesystem::path relative = folder.lexically_relative(top);
+        return !relative.empty() && relative != "." && *relative.begin() != "..";
+    };
+    std::set<std::string> parents;
+    for (const std::string& path : paths) {
+        std::filesystem::path folder = std::filesystem::path(path).lexically_normal().parent_path();
+        while (parents.insert(folder.string()).second && below(folder)) {
+            folder = folder.parent_path();
+        }
+    }
+    return {parents.begin(), parents.end()};
+}
+
+}
+
+// Constructor
+Journal::Journal(const std::string& repoPath)
+    : repoPath(repoPath), journalPath(repoPath + "/history/journal"), pendingPath(repoPath + "/history/pending") {
+}
+
+std::string Journal::stage(const std::string& target) {
+    std::filesystem::create_directories(pendingPath);
+    std::string name = "pending/" + std::to_string(staged.size());
+    std::string relativeTarget = std::filesystem::path(target).lexically_relative(repoPath).generic_string();
+    staged.emplace_back("history/" + name, relativeTarget);
+    std::string path = repoPath + "/history/" + name;
+    std::filesystem::remove(path); // Left by an abandoned transaction
+    return path;
+}
+
+void Journal::requireDurable(const std::string& path) {
+    durable.push_back(path);
+}
+
+void Journal::commit(ThreadPool* pool) {
+    Trace::Span span(Trace::Metadata, "journal commit");
+    std::vector<std::pair<std::string, std::string>> renames = std::move(staged);
+    staged.clear();
+    try {
+        // 1. Everything the new metadata refers to, and the metadata itself
+        std::vector<std::string> files = std::move(durable);
+        durable.clear();
+        for (const auto& [stagedFile, target] : renames) {
+            files.push_back(repoPath + "/" + stagedFile);
+        }
+        syncAll(files, false, pool);
+        syncAll(parentsOf(files, repoPath), true, pool);
+
+        // 2. The commit point
+        std::ostringstream lines;
+        lines << JOURNAL_HEADER << "\n";
+        for (const auto& [stagedFile, target] : renames) {
+            lines << stagedFile << "," << target << "\n";
+        }
+        std::ofstream journalFile(journalPath, std::ios::binary | std::ios::trunc);
+        journalFile << lines.str() << "commit," << renames.size() << "," << checksumOf(lines.str()) << "\n";
+        journalFile.close();
+        if (!journalFile) {
+            throw std::runtime_error("Failed to write journal: " + journalPath);
+        }
+        FileHandler::syncFile(journalPath);
+        FileHandler::syncDirectory(std::filesystem::path(journalPath).parent_path().string());
+    } catch (...) {
+        for (const auto& [stagedFile, target] : renames) {
+            std::filesystem::remove(repoPath + "/" + stagedFile);
+        }
+        std::filesystem::remove(journalPath);
+        throw;
+    }
+
+    // 3. From here on a crash is repaired by recover
+    replay(renames);
+}
+
+void Journal::abort() {
+    for (const auto& [stagedFile, target] : staged) {
+        std::filesystem::remove(repoPath + "/" + stagedFile);
+    }
+    staged.clear();
+    durable.clear();
+}
+
+bool Journal::recover() {
+    if (!std::filesystem::exists(journalPath)) {
+        clear(); // Staged files of a transaction that never committed
+        return false;
+    }
+
+    std::ifstream journalFile(journalPath, std::ios::binary);
+    std::ostringstream lines;
+    std::vector<std::pair<std::string, std::string>> renames;
+    std::string line;
+    bool complete = false;
+    if (std::getline(journalFile, line) && line == JOURNAL_HEADER) {
+        lines << line << "\n";
+        while (std::getline(journalFile, line)) {
+            size_t comma = line.find(',');
+            if (comma == std::string::npos) break;
+            std::string first = line.substr(0, comma), second = line.substr(comma + 1);
+            if (first == "commit") {
+                complete = second == std::to_string(renames.size()) + "," + checksumOf(lines.str());
+                break;
+            }
+            lines << line << "\n";
+            renames.emplace_back(first, second);
+        }
+    }
+    journalFile.close();
+
+    if (!complete) {
+        std::cerr << "Discarding an incomplete transaction in " << repoPath << std::endl;
+        clear();
+        return false;
+    }
+    std::cerr << "Completing an interrupted transaction in " << repoPath << std::endl;
+    replay(renames);
+    return true;
+}
+
+// Renames already done are skipped, so replaying twice is harmless
+void Journal::replay(const std::vector<std::pair<std::string, std::string>>& renames) {
+    std::vector<std::string> targets;
+    for (const auto& [stagedFile, target] : renames) {
+        std::string stagedPath = repoPath + "/" + stagedFile, targetPath = repoPath + "/" + target;
+        if (std::filesystem::exists(stagedPath)) {
+            std::filesystem::create_directories(std::filesystem::path(targetPath).parent_path()); // A restored folder
+            std::filesystem::rename(stagedPath, targetPath);
+        }
+        targets.push_back(targetPath);
+    }
+    // The renames must be on disk before the journal that repeats them goes away
+    syncAll(parentsOf(targets, repoPath), true, nullptr);
+    clear();
+}
+
+void Journal::clear() {
+    std::filesystem::remove(journalPath);
+    std::error_code error;
+    std::filesystem::remove_all(pendingPath, error);
+}
@@ -0,0 +1,45 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+// All-or-nothing replacement of several files: metadata (records, version, manifest...)
+// and, for a rollback, the working files it restores.
+// New contents are written to staged files under history/pending, which replace
+// their targets when the transaction commits:
+//   1. the staged files, and the files they depend on (objects), are flushed to disk
+//   2. the journal, history/journal, lists the renames and ends with a checksum;
+//      once it is flushed, the transaction has committed
+//   3. the staged files are renamed over their targets and the journal is removed
+// If the process stops before step 2 completes, the targets are untouched and the
+// staged files are dropped on the next open; after it, recover replays the renames.
+// The flushes of a transaction are batched at commit and run in parallel.
+class Journal {
+public:
+    Journal(const std::string& repoPath);
+
+    // Path to write the new content of `target` to
+    std::string stage(const std::string& target);
+    // A file written outside the journal that must be on disk before the commit
+    void requireDurable(const std::string& path);
+    void commit(ThreadPool* pool = nullptr);
+    void abort(); // Drop the staged files
+    // Finish a commit interrupted after its journal was written, or drop one interrupted
+    // before. Returns whether there was one to finish.
+    bool recover();
+private:
+    std::string repoPath;
+    std::string journalPath;
+    std::string pendingPath; // Folder of the staged files
+    std::vector<std::pair<std::string, std::string>> staged; // Staged file and target, relative to the repository
+    std::vector<std::string> durable;
+
+    void replay(const std::vector<std::pair<std::string, std::string>>& renames);
+    void clear();
+};
+
+#endif // JOURNAL_H
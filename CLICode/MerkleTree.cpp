@@ -0,0 +1,248 @@
+#include "MerkleTree.h"
+#include "Trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Rank used by PathOrder: '/' first, every other byte after it in its usual order
+int rankOf(char c) {
+    return c == '/' ? 0 : static_cast<unsigned char>(c) + 1;
+}
+
+std::string parentOf(const std::string& key) {
+    return key.substr(0, key.rfind('/'));
+}
+
+size_t depthOf(const std::string& key) {
+    return static_cast<size_t>(std::count(key.begin(), key.end(), '/'));
+}
+
+}
+
+bool MerkleTree::PathOrder::operator()(const std::string& a, const std::string& b) const {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+                                        [](char x, char y) { return rankOf(x) < rankOf(y); });
+}
+
+// Constructor
+MerkleTree::MerkleTree(const std::string& treePath)
+    : treePath(treePath) {
+}
+
+std::string MerkleTree::keyOf(const std::string& path) {
+    std::string key = std::filesystem::path(path).generic_string();
+    while (key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+    return key;
+}
+
+// Nodes strictly below `folder`
+std::pair<MerkleTree::Iterator, MerkleTree::Iterator> MerkleTree::subtree(const Nodes& nodes, const std::string& folder) {
+    return {nodes.lower_bound(folder + "/"), skipSubtree(nodes, folder)};
+}
+
+// First node after `folder` and everything below it. No path contains '\0',
+// which ranks right after '/', so folder + '\0' is past the whole subtree.
+MerkleTree::Iterator MerkleTree::skipSubtree(const Nodes& nodes, const std::string& folder) {
+    return nodes.lower_bound(folder + std::string(1, '\0'));
+}
+
+// Rows are type,digest,path with type f for files and d for folders
+void MerkleTree::load() {
+    nodes.clear();
+    std::ifstream treeFile(treePath);
+    if (!treeFile.is_open()) {
+        return;
+    }
+
+    std::string line;
+    std::getline(treeFile, line); // Skip the header line
+    while (std::getline(treeFile, line)) {
+        size_t digestEnd = line.find(',', 2);
+        if (line.size() < 2 || line[1] != ',' || digestEnd == std::string::npos) {
+            continue;
+        }
+        Node node;
+        node.isFolder = line[0] == 'd';
+        node.digest = line.substr(2, digestEnd - 2);
+        nodes[line.substr(digestEnd + 1)] = node;
+    }
+}
+
+void MerkleTree::save() {
+    std::filesystem::create_directories(std::filesystem::path(treePath).parent_path());
+    std::string tempPath = treePath + ".tmp";
+    saveTo(tempPath);
+    std::filesystem::rename(tempPath, treePath);
+}
+
+void MerkleTree::saveTo(const std::string& path) const {
+    Trace::Span span(Trace::Metadata, "save tree");
+    std::ofstream treeFile(path);
+    if (!treeFile.is_open()) {
+        throw std::runtime_error("Failed to open folder tree for writing.");
+    }
+    treeFile << "type,digest,path\n";
+    for (const auto& [path, node] : nodes) {
+        treeFile << (node.isFolder ? 'd' : 'f') << "," << node.digest << "," << path << "\n";
+    }
+    treeFile.close();
+    if (!treeFile) {
+        throw std::runtime_error("Failed to write folder tree.");
+    }
+}
+
+const std::string& MerkleTree::path() const {
+    return treePath;
+}
+
+std::string MerkleTree::update(const std::string& folder, const std::vector<std::pair<std::string, std::string>>& fileDigests,
+                               Digest::Algorithm algorithm) {
+    std::string root = keyOf(folder);
+
+    // Previous state of the subtree, with the number of direct children of each folder
+    Nodes previous;
+    std::map<std::string, size_t> previousChildCount;
+    auto oldRoot = nodes.find(root);
+    if (oldRoot != nodes.end()) {
+        previous.insert(*oldRoot);
+    }
+    auto [first, last] = subtree(nodes, root);
+    for (auto it = first; it != last; ++it) {
+        previous.insert(*it);
+        previousChildCount[parentOf(it->first)]++;
+    }
+
+    // Files and the folders leading to them, each listed under its parent
+    Nodes fresh;
+    std::map<std::string, std::vector<std::string>> children;
+    fresh[root] = {"", true};
+    for (const auto& [path, digest] : fileDigests) {
+        std::string key = keyOf(path);
+        fresh[key] = {digest, false};
+        children[parentOf(key)].push_back(key);
+        std::string ancestor = parentOf(key);
+        while (ancestor != root && fresh.find(ancestor) == fresh.end()) {
+            fresh[ancestor] = {"", true};
+            children[parentOf(ancestor)].push_back(ancestor);
+            ancestor = parentOf(ancestor);
+        }
+    }
+
+    // Deepest folders first, so children are final when their parent is hashed
+    std::vector<std::string> folders;
+    for (const auto& [path, node] : fresh) {
+        if (node.isFolder) {
+            folders.push_back(path);
+        }
+    }
+    std::stable_sort(folders.begin(), folders.end(),
+                     [](const std::string& a, const std::string& b) { return depthOf(a) > depthOf(b); });
+
+    for (const std::string& folderKey : folders) {
+        std::vector<std::string>& kids = children[folderKey];
+        std::sort(kids.begin(), kids.end(), PathOrder());
+
+        auto old = previous.find(folderKey);
+        bool changed = old == previous.end() || previousChildCount[folderKey] != kids.size();
+        for (size_t i = 0; i < kids.size() && !changed; i++) {
+            auto oldKid = previous.find(kids[i]);
+            const Node& kid = fresh[kids[i]];
+            changed = oldKid == previous.end() || oldKid->second.isFolder != kid.isFolder || oldKid->second.digest != kid.digest;
+        }
+        if (!changed) {
+            fresh[folderKey].digest = old->second.digest;
+            continue;
+        }
+
+        std::unique_ptr<Digest> hasher = Digest::create(algorithm);
+        for (const std::string& kidKey : kids) {
+            const Node& kid = fresh[kidKey];
+            std::string entry = (kid.isFolder ? "d " : "f ") + kid.digest + " " + kidKey.substr(folderKey.size() + 1) + "\n";
+            hasher->update(entry.data(), entry.size());
+        }
+        fresh[folderKey].digest = hasher->hexDigest();
+    }
+
+    remove(root);
+    std::string digest = fresh[root].digest;
+    nodes.insert(fresh.begin(), fresh.end());
+    return digest;
+}
+
+void MerkleTree::remove(const std::string& folder) {
+    std::string root = keyOf(folder);
+    auto [first, last] = subtree(nodes, root);
+    nodes.erase(first, last);
+    nodes.erase(root);
+}
+
+void MerkleTree::copySubtree(const MerkleTree& other, const std::string& folder) {
+    std::string root = keyOf(folder);
+    remove(root);
+    auto otherRoot = other.nodes.find(root);
+    if (otherRoot == other.nodes.end()) {
+        return;
+    }
+    nodes.insert(*otherRoot);
+    auto [first, last] = subtree(other.nodes, root);
+    nodes.insert(first, last);
+}
+
+void MerkleTree::copyAll(const MerkleTree& other) {
+    nodes = other.nodes;
+}
+
+bool MerkleTree::contains(const std::string& folder) const {
+    return nodes.find(keyOf(folder)) != nodes.end();
+}
+
+std::vector<std::pair<std::string, std::string>> MerkleTree::files(const std::string& folder) const {
+    std::vector<std::pair<std::string, std::string>> result;
+    auto [first, last] = subtree(nodes, keyOf(folder));
+    for (auto it = first; it != last; ++it) {
+        if (!it->second.isFolder) {
+            result.emplace_back(it->first, it->second.digest);
+        }
+    }
+    return result;
+}
+
+// Walks both trees in order, skipping every folder whose digest is the same in both
+std::vector<std::string> MerkleTree::changedFiles(const MerkleTree& base, const std::string& folder) const {
+    std::vector<std::string> changed;
+    std::string root = keyOf(folder);
+    auto ownRoot = nodes.find(root);
+    auto baseRoot = base.nodes.find(root);
+    if (ownRoot != nodes.end() && baseRoot != base.nodes.end() && ownRoot->second.digest == baseRoot->second.digest) {
+        return changed;
+    }
+
+    auto [a, aEnd] = subtree(nodes, root);
+    auto [b, bEnd] = subtree(base.nodes, root);
+    PathOrder before;
+    while (a != aEnd || b != bEnd) {
+        if (b == bEnd || (a != aEnd && before(a->first, b->first))) {
+            if (!a->second.isFolder) changed.push_back(a->first); // Added
+            ++a;
+        } else if (a == aEnd || before(b->first, a->first)) {
+            if (!b->second.isFolder) changed.push_back(b->first); // Removed
+            ++b;
+        } else if (a->second.isFolder && b->second.isFolder && a->second.digest == b->second.digest) {
+            a = skipSubtree(nodes, a->first);
+            b = skipSubtree(base.nodes, b->first);
+        } else {
+            bool bothFolders = a->second.isFolder && b->second.isFolder;
+            if (!bothFolders && (a->second.isFolder != b->second.isFolder || a->second.digest != b->second.digest)) {
+                changed.push_back(a->first); // Modified, or replaced by a folder of the same name
+            }
+            ++a;
+            ++b;
+        }
+    }
+    return changed;
+}
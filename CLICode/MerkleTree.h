@@ -0,0 +1,58 @@
+#ifndef MERKLE_TREE_H
+#define MERKLE_TREE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Digest.h"
+
+// Digests of every file and folder under the tracked folders. A folder's digest
+// is the hash of its direct children sorted by name, so it does not depend on
+// directory iteration order, a change to one file only alters the digests of
+// the folders on its path, and comparing two trees only descends into
+// folders whose digests differ.
+class MerkleTree {
+public:
+    MerkleTree(const std::string& treePath);
+    void load();
+    void save();
+    void saveTo(const std::string& path) const; // Same content in another file, such as a staged one
+    const std::string& path() const;
+
+    // Rebuild the subtree of `folder` from the digests of all files under it and
+    // return the folder's digest. Folders whose children are unchanged keep their digest.
+    std::string update(const std::string& folder, const std::vector<std::pair<std::string, std::string>>& fileDigests,
+                       Digest::Algorithm algorithm);
+    void remove(const std::string& folder);
+    void copySubtree(const MerkleTree& other, const std::string& folder);
+    void copyAll(const MerkleTree& other);
+    bool contains(const std::string& folder) const;
+
+    // Files under `folder` with their digests, in path order
+    std::vector<std::pair<std::string, std::string>> files(const std::string& folder) const;
+    // Files under `folder` that were added, removed or modified relative to `base`
+    std::vector<std::string> changedFiles(const MerkleTree& base, const std::string& folder) const;
+
+    static std::string keyOf(const std::string& path); // Normalized '/'-separated path used as key
+private:
+    struct Node {
+        std::string digest;
+        bool isFolder = false;
+    };
+
+    // Orders '/' before every other character, so the nodes under a folder
+    // directly follow the folder itself ("a", "a/b", "a.txt")
+    struct PathOrder {
+        bool operator()(const std::string& a, const std::string& b) const;
+    };
+    using Nodes = std::map<std::string, Node, PathOrder>;
+    using Iterator = Nodes::const_iterator;
+
+    std::string treePath;
+    Nodes nodes;
+
+    static std::pair<Iterator, Iterator> subtree(const Nodes& nodes, const std::string& folder);
+    static Iterator skipSubtree(const Nodes& nodes, const std::string& folder);
+};
+
+#endif // MERKLE_TREE_H
@@ -0,0 +1,1029 @@
+#include "ObjectStore.h"
+#include "Digest.h"
+#include "Delta.h"
+#include "FileHandler.h"
+#include "Trace.h"
+#include <zlib.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <random>
+#include <iterator>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+
+const size_t CHUNK_SIZE = 64 * 1024;
+const char OBJECT_MAGIC[4] = {'Z', 'O', 'B', '1'}; // Single zlib stream, written by older versions
+// Blocked objects: magic, then blocks of codec (u8), raw size and stored size (u32 little-endian)
+// and the stored bytes, ended by a block of raw size 0. Blocks are compressed independently.
+const char BLOCKED_MAGIC[4] = {'Z', 'O', 'B', '2'};
+const size_t BLOCK_SIZE = 1024 * 1024;
+const size_t BLOCK_HEADER_SIZE = 9;
+// Delta objects: magic, chain depth (u32 little-endian), base object id, deflated delta
+const char DELTA_MAGIC[4] = {'Z', 'O', 'D', '1'};
+const size_t OBJECT_ID_SIZE = 64;
+const unsigned MAX_CHAIN_DEPTH = 10;
+const uintmax_t MAX_DELTA_SOURCE = 16 * 1024 * 1024; // Larger files are only stored whole, without reading them into memory
+// Delta encodes hold a file and its base in memory; those running at once share this much
+const uint64_t MAX_DELTA_MEMORY = 64 * 1024 * 1024;
+// Packs: objects up to this size are moved into them, when there are at least MIN_PACK_OBJECTS
+const uintmax_t MAX_PACKED_OBJECT = 256 * 1024;
+const size_t MIN_PACK_OBJECTS = 16;
+const char* PACK_INDEX_HEADER = "object,offset,length";
+// Scratch files younger than this may belong to a store still in progress
+const std::chrono::hours STALE_TEMPORARY(1);
+
+std::string sha256Of(const std::string& content) {
+    std::unique_ptr<Digest> digest = Digest::create(Digest::Strong);
+    digest->update(content.data(), content.size());
+    return digest->hexDigest();
+}
+
+std::string deflateString(const std::string& data) {
+    uLongf size = compressBound(static_cast<uLong>(data.size()));
+    std::string compressed(size, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &size, reinterpret_cast<const Bytef*>(data.data()),
+                  static_cast<uLong>(data.size()), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        throw std::runtime_error("Failed to compress object.");
+    }
+    compressed.resize(size);
+    return compressed;
+}
+
+// Inflate the rest of an object file, passing the content to `sink` chunk by chunk
+void inflateStream(std::istream& in, const std::string& objectId, const std::function<void(const char*, size_t)>& sink) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        throw std::runtime_error("Failed to initialize object decompression.");
+    }
+    std::vector<char> input(CHUNK_SIZE);
+    std::vector<char> output(CHUNK_SIZE);
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        in.read(input.data(), input.size());
+        std::streamsize bytesRead = in.gcount();
+        if (bytesRead == 0) {
+            break;
+        }
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(bytesRead);
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = static_cast<uInt>(output.size());
+            status = inflate(&stream, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END) {
+                inflateEnd(&stream);
+                throw std::runtime_error("Corrupted object in history: " + objectId);
+            }
+            try {
+                sink(output.data(), output.size() - stream.avail_out);
+            } catch (...) {
+                inflateEnd(&stream);
+                throw;
+            }
+        } while (stream.avail_out == 0 && status != Z_STREAM_END);
+    }
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        throw std::runtime_error("Truncated object in history: " + objectId);
+    }
+}
+
+std::string inflateStream(std::istream& in, const std::string& objectId) {
+    std::string content;
+    inflateStream(in, objectId, [&content](const char* data, size_t size) { content.append(data, size); });
+    return content;
+}
+
+void appendLE32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+uint32_t readLE32(const unsigned char* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// One block with its header; stored as is when compressing would not make it smaller
+std::string encodeBlock(const std::string& raw, CompressionPolicy::Rule rule) {
+    Trace::Span span(Trace::Compress, "compress block");
+    std::string compressed;
+    if (rule.codec == CompressionPolicy::Deflate) {
+        uLongf size = compressBound(static_cast<uLong>(raw.size()));
+        compressed.resize(size);
+        if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &size, reinterpret_cast<const Bytef*>(raw.data()),
+                      static_cast<uLong>(raw.size()), rule.level) != Z_OK) {
+            throw std::runtime_error("Failed to compress object.");
+        }
+        compressed.resize(size);
+    }
+    bool deflated = rule.codec == CompressionPolicy::Deflate && compressed.size() < raw.size();
+    const std::string& payload = deflated ? compressed : raw;
+
+    std::string block;
+    block.reserve(BLOCK_HEADER_SIZE + payload.size());
+    block.push_back(static_cast<char>(deflated ? CompressionPolicy::Deflate : CompressionPolicy::Store));
+    appendLE32(block, static_cast<uint32_t>(raw.size()));
+    appendLE32(block, static_cast<uint32_t>(payload.size()));
+    block += payload;
+    return block;
+}
+
+// Decompress the stored bytes of a block into `raw`
+void decodeBlock(uint8_t codec, const std::string& stored, uint32_t rawSize, const std::string& objectId, std::string& raw) {
+    if (codec == CompressionPolicy::Store && stored.size() == rawSize) {
+        raw = stored;
+        return;
+    }
+    raw.resize(rawSize);
+    uLongf size = rawSize;
+    Trace::Span span(Trace::Compress, "decompress block");
+    if (codec != CompressionPolicy::Deflate ||
+        uncompress(reinterpret_cast<Bytef*>(&raw[0]), &size, reinterpret_cast<const Bytef*>(stored.data()),
+                   static_cast<uLong>(stored.size())) != Z_OK || size != rawSize) {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+}
+
+// Pass the blocks of a blocked object to `sink`, one block in memory at a time
+void readBlocks(std::istream& in, const std::string& objectId, const std::function<void(const char*, size_t)>& sink) {
+    std::string stored, raw;
+    while (true) {
+        unsigned char header[BLOCK_HEADER_SIZE];
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        uint32_t rawSize = readLE32(header + 1), storedSize = readLE32(header + 5);
+        if (!in || rawSize > BLOCK_SIZE || storedSize > compressBound(BLOCK_SIZE)) {
+            throw std::runtime_error("Corrupted object in history: " + objectId);
+        }
+        if (rawSize == 0) {
+            return;
+        }
+        stored.resize(storedSize);
+        in.read(&stored[0], storedSize);
+        if (!in) {
+            throw std::runtime_error("Truncated object in history: " + objectId);
+        }
+        if (header[0] == CompressionPolicy::Store && storedSize == rawSize) {
+            sink(stored.data(), stored.size());
+            continue;
+        }
+        decodeBlock(header[0], stored, rawSize, objectId, raw);
+        sink(raw.data(), raw.size());
+    }
+}
+
+// Writes the blocks of an object in order while the pool compresses the following ones.
+// Blocks in flight are bounded per object and across the store, so memory stays bounded
+// however large the files and however many are stored at once.
+class BlockWriter {
+public:
+    BlockWriter(std::ostream& out, CompressionPolicy::Rule rule, ThreadPool* pool, std::atomic<unsigned>& inFlight)
+        : out(out), rule(rule), pool(pool), inFlight(inFlight), maxInFlight(pool ? 2 * pool->size() : 0) {
+        out.write(BLOCKED_MAGIC, sizeof(BLOCKED_MAGIC));
+    }
+
+    ~BlockWriter() {
+        // Tasks of an abandoned object still have to finish before the writer goes away
+        for (auto& block : pending) {
+            try {
+                pool->wait(block);
+            } catch (...) {
+            }
+        }
+    }
+
+    void add(const char* data, size_t size) {
+        while (size > 0) {
+            size_t length = std::min(size, BLOCK_SIZE - block.size());
+            block.append(data, length);
+            data += length;
+            size -= length;
+            if (block.size() == BLOCK_SIZE) {
+                submit();
+            }
+        }
+    }
+
+    // The last block is compressed on the calling thread; a small file is a single block
+    void finish() {
+        while (!pending.empty()) {
+            writeFront();
+        }
+        if (!block.empty()) {
+            std::string encoded = encodeBlock(block, rule);
+            Trace::Span span(Trace::Write, "write block");
+            out << encoded;
+        }
+        std::string end;
+        end.push_back(static_cast<char>(CompressionPolicy::Store));
+        appendLE32(end, 0);
+        appendLE32(end, 0);
+        out << end;
+    }
+
+private:
+    std::ostream& out;
+    CompressionPolicy::Rule rule;
+    ThreadPool* pool;
+    std::atomic<unsigned>& inFlight;
+    unsigned maxInFlight;
+    std::string block;
+    std::deque<std::future<std::string>> pending;
+
+    void submit() {
+        if (!pool) {
+            std::string encoded = encodeBlock(block, rule);
+            Trace::Span span(Trace::Write, "write block");
+            out << encoded;
+            block.clear();
+            return;
+        }
+        while (!pending.empty() && (pending.size() >= maxInFlight || inFlight >= maxInFlight)) {
+            writeFront();
+        }
+        inFlight++;
+        CompressionPolicy::Rule blockRule = rule;
+        std::atomic<unsigned>* counter = &inFlight;
+        pending.push_back(pool->submit([raw = std::move(block), blockRule, counter]() {
+            struct Release {
+                std::atomic<unsigned>* counter;
+                ~Release() { (*counter)--; }
+            } release{counter};
+            return encodeBlock(raw, blockRule);
+        }));
+        block = std::string();
+        block.reserve(BLOCK_SIZE);
+    }
+
+    void writeFront() {
+        std::future<std::string> front = std::move(pending.front());
+        pending.pop_front();
+        std::string encoded = pool->wait(front);
+        Trace::Span span(Trace::Write, "write block");
+        out << encoded;
+    }
+};
+
+// Objects listed in a pack's index, pack_N.idx, with their slices of pack_N.pack
+std::vector<std::pair<std::string, ObjectStore::Location>> readPackIndex(const std::string& indexPath) {
+    std::vector<std::pair<std::string, ObjectStore::Location>> entries;
+    std::ifstream indexFile(indexPath);
+    std::string packFile = std::filesystem::path(indexPath).replace_extension(".pack").string();
+    std::string line;
+    std::getline(indexFile, line); // Header
+    while (std::getline(indexFile, line)) {
+        std::stringstream linestream(line);
+        std::string objectId, offset, length;
+        std::getline(linestream, objectId, ',');
+        std::getline(linestream, offset, ',');
+        std::getline(linestream, length);
+        if (objectId.size() != OBJECT_ID_SIZE || offset.empty() || length.empty()) {
+            throw std::runtime_error("Corrupted pack index: " + indexPath);
+        }
+        entries.push_back({objectId, {packFile, std::stoull(offset), std::stoull(length)}});
+    }
+    return entries;
+}
+
+// Index files of the packs, in name order
+std::vector<std::string> packIndexes(const std::string& packPath) {
+    std::vector<std::string> indexes;
+    if (std::filesystem::is_directory(packPath)) {
+        for (const auto& entry : std::filesystem::directory_iterator(packPath)) {
+            if (entry.path().extension() == ".idx") {
+                indexes.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(indexes.begin(), indexes.end());
+    return indexes;
+}
+
+// Header of a delta object, after its magic
+struct DeltaHeader {
+    unsigned depth = 0;
+    std::string baseId;
+};
+
+DeltaHeader readDeltaHeader(std::istream& in, const std::string& objectId) {
+    unsigned char depth[4];
+    DeltaHeader header;
+    header.baseId.resize(OBJECT_ID_SIZE);
+    in.read(reinterpret_cast<char*>(depth), sizeof(depth));
+    in.read(&header.baseId[0], OBJECT_ID_SIZE);
+    if (!in) {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+    header.depth = depth[0] | depth[1] << 8 | depth[2] << 16 | static_cast<unsigned>(depth[3]) << 24;
+    return header;
+}
+
+}
+
+bool ObjectStore::Location::operator==(const Location& other) const {
+    return file == other.file && offset == other.offset && length == other.length;
+}
+
+// Constructor
+ObjectStore::ObjectStore(const std::string& objectsPath)
+    : basePath(objectsPath) {
+}
+
+// Location of an object inside the store, fanned out by the first byte of its id
+std::string ObjectStore::objectPath(const std::string& objectId) {
+    return basePath + "/" + objectId.substr(0, 2) + "/" + objectId.substr(2);
+}
+
+// Unique scratch file that a new object is written to before it gets its final name
+std::string ObjectStore::temporaryPath() {
+    thread_local std::random_device device; // Objects are stored from several threads at once
+    std::stringstream ss;
+    ss << basePath << "/tmp_" << std::hex << device() << device();
+    return ss.str();
+}
+
+void ObjectStore::setThreadPool(ThreadPool* pool) {
+    this->pool = pool;
+}
+
+CompressionPolicy& ObjectStore::compression() {
+    return policy;
+}
+
+// Packs are not read again when an object is missing, since most stores ask for new contents
+bool ObjectStore::contains(const std::string& objectId) {
+    Location location;
+    return std::filesystem::exists(objectPath(objectId)) || findPacked(objectId, location, false);
+}
+
+std::string ObjectStore::packPath() {
+    return basePath + "/pack";
+}
+
+void ObjectStore::loadPacks() {
+    packed.clear();
+    for (const auto& indexPath : packIndexes(packPath())) {
+        for (auto& [objectId, location] : readPackIndex(indexPath)) {
+            packed.emplace(objectId, std::move(location)); // The first pack holding an object serves it
+        }
+    }
+    packsLoaded = true;
+}
+
+// With `reload`, the packs are read again before giving up, in case another process packed the object
+bool ObjectStore::findPacked(const std::string& objectId, Location& location, bool reload) {
+    std::lock_guard<std::mutex> lock(packMutex);
+    if (!packsLoaded) {
+        loadPacks();
+        reload = false;
+    }
+    auto found = packed.find(objectId);
+    if (found == packed.end() && reload) {
+        loadPacks();
+        found = packed.find(objectId);
+    }
+    if (found == packed.end()) {
+        return false;
+    }
+    location = found->second;
+    return true;
+}
+
+ObjectStore::Location ObjectStore::locate(const std::string& objectId) {
+    Location location;
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(objectPath(objectId), error);
+    if (!error) {
+        location.file = objectPath(objectId);
+        location.length = size;
+        return location;
+    }
+    if (!findPacked(objectId, location, true)) {
+        throw std::runtime_error("Missing object in history: " + objectId);
+    }
+    return location;
+}
+
+std::string ObjectStore::fileOf(const std::string& objectId) {
+    return locate(objectId).file;
+}
+
+// An object may move into a pack, or to another pack, between being located and opened
+std::ifstream ObjectStore::open(const std::string& objectId, Location& location) {
+    location = locate(objectId);
+    std::ifstream inFile(location.file, std::ios::binary);
+    if (!inFile.is_open()) {
+        {
+            std::lock_guard<std::mutex> lock(packMutex);
+            packsLoaded = false;
+        }
+        location = locate(objectId);
+        inFile.open(location.file, std::ios::binary);
+        if (!inFile.is_open()) {
+            throw std::runtime_error("Missing object in history: " + objectId);
+        }
+    }
+    inFile.seekg(static_cast<std::streamoff>(location.offset));
+    return inFile;
+}
+
+// Base of the copy of an object at `location`, which collect checks for each copy
+std::string ObjectStore::baseAt(const std::string& objectId, const Location& location) {
+    std::ifstream inFile(location.file, std::ios::binary);
+    inFile.seekg(static_cast<std::streamoff>(location.offset));
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    if (!inFile) {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+    return std::equal(magic, magic + sizeof(magic), DELTA_MAGIC) ? readDeltaHeader(inFile, objectId).baseId : "";
+}
+
+std::string ObjectStore::baseOf(const std::string& objectId) {
+    Location location;
+    std::ifstream inFile = open(objectId, location);
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    if (!inFile) {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+    return std::equal(magic, magic + sizeof(magic), DELTA_MAGIC) ? readDeltaHeader(inFile, objectId).baseId : "";
+}
+
+// Give a finished object file its final name, replacing any previous encoding of the same content
+void ObjectStore::install(const std::string& tempPath, const std::string& objectId) {
+    std::string finalPath = objectPath(objectId);
+    std::filesystem::create_directories(std::filesystem::path(finalPath).parent_path());
+    std::filesystem::rename(tempPath, finalPath);
+}
+
+// Hash and compress a file in a single streaming pass. The content is only kept
+// when no object with the same digest exists yet, as a delta against `baseId`
+// when that is smaller.
+std::string ObjectStore::store(const std::string& filepath, const std::string& baseId) {
+    Trace::Span span(Trace::File, "store file", filepath);
+    std::filesystem::create_directories(basePath);
+    std::string tempPath = temporaryPath();
+    std::ofstream outFile(tempPath, std::ios::binary);
+    if (!outFile.is_open()) {
+        throw std::runtime_error("Could not create object file in: " + basePath);
+    }
+
+    // The next chunk is read while this one is hashed, and blocks are compressed on the pool
+    std::unique_ptr<Digest> digest = Digest::create(Digest::Strong);
+    uint64_t storedBytes = 0;
+    try {
+        BlockWriter writer(outFile, policy.ruleFor(filepath), pool, blocksInFlight);
+        FileHandler::streamFile(filepath, [&](const char* data, size_t size) {
+            {
+                Trace::Span span(Trace::Hash, nullptr);
+                digest->update(data, size);
+            }
+            writer.add(data, size);
+            storedBytes += size;
+        });
+        writer.finish();
+    } catch (...) {
+        outFile.close();
+        std::filesystem::remove(tempPath);
+        throw;
+    }
+    outFile.close();
+
+    if (!outFile) {
+        std::filesystem::remove(tempPath);
+        throw std::runtime_error("Failed to write object for: " + filepath);
+    }
+
+    std::string objectId = digest->hexDigest();
+    Trace::count(Trace::FilesStored);
+    Trace::count(Trace::BytesStored, storedBytes);
+    if (contains(objectId)) {
+        std::filesystem::remove(tempPath); // Same content is already stored
+        Trace::count(Trace::ObjectsReused);
+        return objectId;
+    }
+
+    uintmax_t fullSize = std::filesystem::file_size(tempPath);
+    if (!baseId.empty() && contains(baseId) && std::filesystem::file_size(filepath) <= MAX_DELTA_SOURCE &&
+        chainDepth(baseId) < MAX_CHAIN_DEPTH) {
+        // Counted as the file and a base of about its size; one encode may always run
+        uint64_t reserved = 2 * std::filesystem::file_size(filepath);
+        {
+            std::unique_lock<std::mutex> lock(deltaMutex);
+            deltaRoom.wait(lock, [this, reserved]() { return deltaBytes == 0 || deltaBytes + reserved <= MAX_DELTA_MEMORY; });
+            deltaBytes += reserved;
+        }
+        struct Release {
+            ObjectStore* store;
+            uint64_t bytes;
+            ~Release() {
+                std::lock_guard<std::mutex> lock(store->deltaMutex);
+                store->deltaBytes -= bytes;
+                store->deltaRoom.notify_all();
+            }
+        } release{this, reserved};
+        try {
+            std::ifstream contentFile(filepath, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(contentFile)), std::istreambuf_iterator<char>());
+            // The file may have changed since it was hashed; only its hashed content may be stored
+            if (sha256Of(content) == objectId && storeDelta(objectId, content, baseId, fullSize)) {
+                std::filesystem::remove(tempPath);
+                Trace::count(Trace::BytesWritten, std::filesystem::file_size(objectPath(objectId)));
+                return objectId;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Storing " << filepath << " whole: " << e.what() << std::endl;
+        }
+    }
+    install(tempPath, objectId);
+    Trace::count(Trace::BytesWritten, fullSize);
+    return objectId;
+}
+
+// Store `content` as a delta against `baseId` if the result is smaller than `sizeLimit` bytes
+bool ObjectStore::storeDelta(const std::string& objectId, const std::string& content, const std::string& baseId,
+                             uintmax_t sizeLimit) {
+    std::string compressed = deflateString(Delta::encode(load(baseId), content));
+    size_t headerSize = sizeof(DELTA_MAGIC) + 4 + OBJECT_ID_SIZE;
+    if (headerSize + compressed.size() >= sizeLimit) {
+        return false;
+    }
+
+    unsigned depth = chainDepth(baseId) + 1;
+    unsigned char depthBytes[4] = {static_cast<unsigned char>(depth), static_cast<unsigned char>(depth >> 8),
+                                   static_cast<unsigned char>(depth >> 16), static_cast<unsigned char>(depth >> 24)};
+    std::string tempPath = temporaryPath();
+    std::ofstream outFile(tempPath, std::ios::binary);
+    outFile.write(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+    outFile.write(reinterpret_cast<const char*>(depthBytes), sizeof(depthBytes));
+    outFile.write(baseId.data(), OBJECT_ID_SIZE);
+    outFile.write(compressed.data(), compressed.size());
+    outFile.close();
+    if (!outFile) {
+        std::filesystem::remove(tempPath);
+        throw std::runtime_error("Failed to write object: " + objectId);
+    }
+    install(tempPath, objectId);
+    return true;
+}
+
+void ObjectStore::storeFull(const std::string& objectId, const std::string& content) {
+    std::string tempPath = temporaryPath();
+    std::ofstream outFile(tempPath, std::ios::binary);
+    {
+        BlockWriter writer(outFile, CompressionPolicy().ruleFor(""), pool, blocksInFlight);
+        writer.add(content.data(), content.size());
+        writer.finish();
+    }
+    outFile.close();
+    if (!outFile) {
+        std::filesystem::remove(tempPath);
+        throw std::runtime_error("Failed to write object: " + objectId);
+    }
+    install(tempPath, objectId);
+}
+
+unsigned ObjectStore::chainDepth(const std::string& objectId) {
+    Location location;
+    std::ifstream inFile = open(objectId, location);
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    if (!inFile) {
+        throw std::runtime_error("Missing object in history: " + objectId);
+    }
+    return std::equal(magic, magic + sizeof(magic), DELTA_MAGIC) ? readDeltaHeader(inFile, objectId).depth : 0;
+}
+
+// Rebuild an object in memory, checking the result against its id
+std::string ObjectStore::load(const std::string& objectId) {
+    Location location;
+    std::ifstream inFile = open(objectId, location);
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    std::string content;
+    if (inFile && std::equal(magic, magic + sizeof(magic), OBJECT_MAGIC)) {
+        content = inflateStream(inFile, objectId);
+    } else if (inFile && std::equal(magic, magic + sizeof(magic), BLOCKED_MAGIC)) {
+        readBlocks(inFile, objectId, [&content](const char* data, size_t size) { content.append(data, size); });
+    } else if (inFile && std::equal(magic, magic + sizeof(magic), DELTA_MAGIC)) {
+        DeltaHeader header = readDeltaHeader(inFile, objectId);
+        if (header.baseId == objectId) {
+            throw std::runtime_error("Corrupted object in history: " + objectId);
+        }
+        content = Delta::apply(load(header.baseId), inflateStream(inFile, objectId));
+    } else {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+    if (sha256Of(content) != objectId) {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+    return content;
+}
+
+void ObjectStore::repack(const std::vector<std::vector<std::string>>& histories) {
+    auto storeSize = [this]() {
+        uintmax_t total = 0;
+        if (std::filesystem::exists(basePath)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(basePath)) {
+                if (entry.is_regular_file()) total += entry.file_size();
+            }
+        }
+        return total;
+    };
+    uintmax_t sizeBefore = storeSize();
+
+    // Packed objects keep their encoding: a second, loose one would shadow it with other bases.
+    // The loose bases of packed deltas stay whole too, so those chains do not grow.
+    auto isLoose = [this](const std::string& objectId) { return std::filesystem::exists(objectPath(objectId)); };
+    std::vector<std::string> packedIds;
+    {
+        std::lock_guard<std::mutex> lock(packMutex);
+        loadPacks();
+        for (const auto& entry : packed) {
+            packedIds.push_back(entry.first);
+        }
+    }
+    std::set<std::string> packedBases;
+    for (const auto& objectId : packedIds) {
+        if (!isLoose(objectId)) {
+            packedBases.insert(baseOf(objectId));
+        }
+    }
+
+    // First make every listed object whole, so no object depends on one that is rewritten later
+    for (const auto& history : histories) {
+        for (const auto& objectId : history) {
+            if (isLoose(objectId) && chainDepth(objectId) > 0) {
+                storeFull(objectId, load(objectId));
+            }
+        }
+    }
+
+    // Then chain each object to its predecessor. An object is only ever based on one
+    // placed before it, or on a packed delta whose chain does not lead back to it,
+    // which rules out cycles.
+    auto chainHas = [this](std::string objectId, const std::string& wanted) {
+        for (; !objectId.empty(); objectId = baseOf(objectId)) {
+            if (objectId == wanted) return true;
+        }
+        return false;
+    };
+    std::map<std::string, unsigned> depths;
+    size_t deltas = 0;
+    for (const auto& history : histories) {
+        std::string previous;
+        for (const auto& objectId : history) {
+            if (!contains(objectId)) {
+                previous.clear();
+                continue;
+            }
+            if (depths.count(objectId) == 0 && !isLoose(objectId)) {
+                depths[objectId] = chainDepth(objectId);
+            } else if (depths.count(objectId) == 0) {
+                uintmax_t size = locate(objectId).length;
+                bool chained = false;
+                if (!previous.empty() && previous != objectId && depths[previous] < MAX_CHAIN_DEPTH &&
+                    packedBases.count(objectId) == 0 && !chainHas(previous, objectId)) {
+                    std::string content = load(objectId);
+                    chained = content.size() <= MAX_DELTA_SOURCE && storeDelta(objectId, content, previous, size);
+                }
+                depths[objectId] = chained ? depths[previous] + 1 : 0;
+                deltas += chained;
+            }
+            previous = objectId;
+        }
+    }
+    std::cout << "Repacked " << depths.size() << " objects (" << deltas << " as deltas): " << sizeBefore << " -> "
+              << storeSize() << " bytes" << std::endl;
+}
+
+// Copy the bytes of objects, each from a file of its own or a pack, into a new pack.
+// The pack only counts once its index is in place, which is written last.
+void ObjectStore::writePack(const std::vector<std::pair<std::string, Location>>& sources, Collection& result) {
+    Trace::Span span(Trace::Write, "write pack");
+    std::string packFolder = packPath();
+    std::filesystem::create_directories(packFolder);
+    std::string tempPack = temporaryPath(), tempIndex = temporaryPath();
+    try {
+        std::ofstream pack(tempPack, std::ios::binary);
+        std::ostringstream index;
+        index << PACK_INDEX_HEADER << "\n";
+        uint64_t offset = 0;
+        std::vector<char> buffer(CHUNK_SIZE);
+        for (const auto& [objectId, source] : sources) {
+            std::ifstream in(source.file, std::ios::binary);
+            in.seekg(static_cast<std::streamoff>(source.offset));
+            for (uint64_t left = source.length; left > 0;) {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+                in.read(buffer.data(), size);
+                if (!in) {
+                    throw std::runtime_error("Missing object in history: " + objectId);
+                }
+                pack.write(buffer.data(), size);
+                left -= size;
+            }
+            index << objectId << "," << offset << "," << source.length << "\n";
+            offset += source.length;
+        }
+        pack.close();
+        std::ofstream indexFile(tempIndex, std::ios::binary);
+        indexFile << index.str();
+        indexFile.close();
+        if (!pack || !indexFile) {
+            throw std::runtime_error("Failed to write pack in: " + packFolder);
+        }
+        FileHandler::syncFile(tempPack);
+        FileHandler::syncFile(tempIndex);
+
+        std::string name = packFolder + "/pack_" + std::filesystem::path(tempPack).filename().string().substr(4);
+        std::filesystem::rename(tempPack, name + ".pack");
+        std::filesystem::rename(tempIndex, name + ".idx");
+        FileHandler::syncDirectory(packFolder);
+    } catch (...) {
+        std::filesystem::remove(tempPack);
+        std::filesystem::remove(tempIndex);
+        throw;
+    }
+    result.objectsPacked += sources.size();
+    result.packsWritten++;
+    std::lock_guard<std::mutex> lock(packMutex);
+    loadPacks();
+}
+
+ObjectStore::Collection ObjectStore::collect(const std::set<std::string>& referenced, uint64_t budget) {
+    namespace fs = std::filesystem;
+    Collection result;
+    if (!fs::exists(basePath)) {
+        return result;
+    }
+    {
+        std::lock_guard<std::mutex> lock(packMutex);
+        loadPacks(); // As they are on disk now
+    }
+
+    // Referenced objects, and the bases their deltas are rebuilt from, are live. An object
+    // stored both loose and in a pack may have a different base in each; below, the loose
+    // copy goes and the packed one stays, so the bases of both are kept.
+    std::set<std::string> live;
+    std::vector<std::string> pending(referenced.begin(), referenced.end());
+    while (!pending.empty()) {
+        std::string objectId = std::move(pending.back());
+        pending.pop_back();
+        if (!live.insert(objectId).second) {
+            continue;
+        }
+        std::vector<Location> copies(1);
+        std::error_code error;
+        copies[0] = {objectPath(objectId), 0, fs::file_size(objectPath(objectId), error)};
+        if (error) {
+            copies.clear();
+        }
+        Location packedCopy;
+        if (findPacked(objectId, packedCopy, false)) {
+            copies.push_back(packedCopy);
+        }
+        for (const Location& copy : copies) {
+            std::string base = baseAt(objectId, copy);
+            if (!base.empty()) {
+                pending.push_back(base);
+            }
+        }
+    }
+
+    // Loose objects that are dead, or already packed, are deleted; small live ones are
+    // gathered for a new pack, as many as the budget allows
+    std::vector<std::pair<std::string, Location>> sources;
+    uint64_t sourceBytes = 0;
+    size_t looseSources = 0;
+    std::vector<fs::directory_entry> entries;
+    for (const auto& folder : fs::directory_iterator(basePath)) {
+        std::string name = folder.path().filename().string();
+        if (folder.is_directory() && name.size() == 2) {
+            for (const auto& file : fs::directory_iterator(folder.path())) {
+                entries.push_back(file);
+            }
+        } else if (folder.is_regular_file() && name.rfind("tmp_", 0) == 0 &&
+                   fs::file_time_type::clock::now() - folder.last_write_time() > STALE_TEMPORARY) {
+            result.bytesReclaimed += folder.file_size(); // Left by an interrupted store
+            fs::remove(folder.path());
+        }
+    }
+    for (const auto& entry : entries) {
+        std::string objectId = entry.path().parent_path().filename().string() + entry.path().filename().string();
+        uintmax_t size = entry.file_size();
+        Location location;
+        bool isPacked = findPacked(objectId, location, false);
+        if (objectId.size() != OBJECT_ID_SIZE || !live.count(objectId) || isPacked) {
+            fs::remove(entry.path());
+            result.objectsRemoved += !isPacked;
+            result.bytesReclaimed += size;
+        } else if (size <= MAX_PACKED_OBJECT) {
+            if (sourceBytes >= budget) {
+                result.finished = false;
+                continue;
+            }
+            sources.push_back({objectId, {entry.path().string(), 0, size}});
+            sourceBytes += size;
+            looseSources++;
+        }
+    }
+    if (looseSources < MIN_PACK_OBJECTS) {
+        sources.clear(); // Too few to be worth a pack
+        sourceBytes = 0;
+    }
+
+    // A pack that is mostly dead (or holds copies served by another pack) is rewritten:
+    // its live objects join the new pack and it is deleted
+    std::vector<std::string> emptied;
+    uint64_t emptiedBytes = 0;
+    for (const auto& indexPath : packIndexes(packPath())) {
+        std::vector<std::pair<std::string, Location>> kept;
+        uint64_t total = 0, liveBytes = 0;
+        for (const auto& [objectId, location] : readPackIndex(indexPath)) {
+            Location served;
+            total += location.length;
+            if (live.count(objectId) && findPacked(objectId, served, false) && served == location) {
+                kept.push_back({objectId, location});
+                liveBytes += location.length;
+            }
+        }
+        if (liveBytes * 2 > total) {
+            continue;
+        }
+        if (liveBytes > 0 && !sources.empty() && sourceBytes + liveBytes > budget) {
+            result.finished = false;
+            continue;
+        }
+        sources.insert(sources.end(), kept.begin(), kept.end());
+        sourceBytes += liveBytes;
+        emptied.push_back(indexPath);
+        emptiedBytes += total - liveBytes;
+    }
+
+    if (!sources.empty()) {
+        writePack(sources, result);
+    }
+    // The live objects are in the new pack: their old copies can go
+    for (const auto& [objectId, source] : sources) {
+        if (source.offset == 0 && source.file == objectPath(objectId)) {
+            fs::remove(source.file);
+        }
+    }
+    for (const auto& indexPath : emptied) {
+        std::string packFile = fs::path(indexPath).replace_extension(".pack").string();
+        fs::remove(indexPath); // Index first: a pack without one is never read
+        fs::remove(packFile);
+        result.packsRemoved++;
+    }
+    result.bytesReclaimed += emptiedBytes;
+
+    // Packs left without an index by an interrupted collection
+    if (fs::is_directory(packPath())) {
+        for (const auto& entry : fs::directory_iterator(packPath())) {
+            if (entry.path().extension() == ".pack" && !fs::exists(fs::path(entry.path()).replace_extension(".idx")) &&
+                fs::file_time_type::clock::now() - entry.last_write_time() > STALE_TEMPORARY) {
+                result.bytesReclaimed += entry.file_size();
+                fs::remove(entry.path());
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(packMutex);
+    loadPacks();
+    return result;
+}
+
+// Pass the content of an object to `sink` in chunks. Whole objects are decompressed
+// in bounded memory; deltas are small by construction and rebuilt in memory.
+void ObjectStore::read(const std::string& objectId, const std::function<void(const char*, size_t)>& sink) {
+    Location location;
+    std::ifstream inFile = open(objectId, location);
+
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    if (inFile && std::equal(magic, magic + sizeof(magic), DELTA_MAGIC)) {
+        inFile.close();
+        std::string content = load(objectId);
+        sink(content.data(), content.size());
+    } else if (inFile && std::equal(magic, magic + sizeof(magic), BLOCKED_MAGIC)) {
+        readBlocks(inFile, objectId, sink);
+    } else if (inFile && std::equal(magic, magic + sizeof(magic), OBJECT_MAGIC)) {
+        inflateStream(inFile, objectId, sink);
+    } else {
+        throw std::runtime_error("Corrupted object in history: " + objectId);
+    }
+}
+
+// Walk the block headers of an object, seeking over the stored bytes
+ObjectStore::Layout ObjectStore::layout(const std::string& objectId) {
+    Layout layout;
+    std::ifstream inFile = open(objectId, layout.location);
+    char magic[sizeof(OBJECT_MAGIC)];
+    inFile.read(magic, sizeof(magic));
+    if (!inFile || !std::equal(magic, magic + sizeof(magic), BLOCKED_MAGIC)) {
+        return layout;
+    }
+    layout.blocked = true;
+    uint64_t position = layout.location.offset + sizeof(BLOCKED_MAGIC);
+    uint64_t end = layout.location.offset + layout.location.length;
+    while (true) {
+        unsigned char header[BLOCK_HEADER_SIZE];
+        inFile.read(reinterpret_cast<char*>(header), sizeof(header));
+        Block block;
+        block.codec = header[0];
+        block.rawSize = readLE32(header + 1);
+        block.storedSize = readLE32(header + 5);
+        if (!inFile || block.rawSize > BLOCK_SIZE || block.storedSize > compressBound(BLOCK_SIZE)) {
+            throw std::runtime_error("Corrupted object in history: " + objectId);
+        }
+        if (block.rawSize == 0) {
+            return layout;
+        }
+        block.offset = layout.size;
+        block.position = position + BLOCK_HEADER_SIZE;
+        position = block.position + block.storedSize;
+        if (position > end) {
+            throw std::runtime_error("Truncated object in history: " + objectId);
+        }
+        layout.size += block.rawSize;
+        layout.blocks.push_back(block);
+        inFile.seekg(static_cast<std::streamoff>(position));
+    }
+}
+
+// Decompress one block of a blocked object, found by layout(). If the object moved
+// since, into a pack or out of a rewritten one, it is laid out again.
+std::string ObjectStore::readBlock(const std::string& objectId, const Layout& layout, size_t index) {
+    std::ifstream inFile(layout.location.file, std::ios::binary);
+    if (!inFile.is_open()) {
+        Layout moved = this->layout(objectId);
+        if (index >= moved.blocks.size()) {
+            throw std::runtime_error("Corrupted object in history: " + objectId);
+        }
+        return readBlock(objectId, moved, index);
+    }
+    const Block& block = layout.blocks.at(index);
+    std::string stored(block.storedSize, '\0'), raw;
+    {
+        Trace::Span span(Trace::Read, nullptr);
+        inFile.seekg(static_cast<std::streamoff>(block.position));
+        inFile.read(&stored[0], block.storedSize);
+    }
+    if (!inFile) {
+        throw std::runtime_error("Truncated object in history: " + objectId);
+    }
+    decodeBlock(block.codec, stored, block.rawSize, objectId, raw);
+    return raw;
+}
+
+// Write an object back into a regular file. It is written beside the file and renamed over
+// it once complete, so a missing or corrupted object, or a cancel, leaves the file as it was.
+void ObjectStore::restore(const std::string& objectId, const std::string& destPath) {
+    Trace::Span span(Trace::File, "restore file", destPath);
+    if (!contains(objectId)) {
+        throw std::runtime_error("Missing object in history: " + objectId);
+    }
+    std::filesystem::path parent = std::filesystem::path(destPath).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent);
+    }
+    std::string tempPath = destPath + ".restore.tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        throw std::runtime_error("Could not open file: " + destPath);
+    }
+    uint64_t bytes = 0;
+    try {
+        read(objectId, [&outFile, &bytes](const char* data, size_t size) {
+            Trace::Span span(Trace::Write, nullptr);
+            outFile.write(data, size);
+            bytes += size;
+        });
+        outFile.close();
+        if (!outFile) {
+            throw std::runtime_error("Could not write file: " + destPath);
+        }
+        std::error_code error;
+        std::filesystem::file_status previous = std::filesystem::status(destPath, error);
+        if (!error && std::filesystem::is_regular_file(previous)) {
+            std::filesystem::permissions(tempPath, previous.permissions()); // Keep an executable executable
+        }
+        std::filesystem::rename(tempPath, destPath);
+    } catch (...) {
+        outFile.close();
+        std::error_code error;
+        std::filesystem::remove(tempPath, error);
+        throw;
+    }
+    Trace::count(Trace::FilesRestored);
+    Trace::count(Trace::BytesRestored, bytes);
+}
@@ -0,0 +1,118 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include "CompressionPolicy.h"
+#include "ThreadPool.h"
+
+// Content-addressed blob storage for committed file contents.
+// Every object holds the content of one file, compressed in independent blocks
+// following a CompressionPolicy, stored under
+// <objects>/<first two hex digits>/<remaining digits> and named by the
+// SHA-256 of the uncompressed content, so identical contents are written once
+// no matter how many paths or versions refer to them.
+//
+// An object is either the content itself, or a deflated Delta against
+// another object (its base), usually the previous version of the same file.
+// Delta chains are cut by a full object every MAX_CHAIN_DEPTH versions, so a
+// content is rebuilt from at most that many deltas.
+//
+// Garbage collection moves small objects into packs, <objects>/pack/pack_N.pack,
+// which hold the bytes of many objects back to back, listed with their offsets in
+// pack_N.idx. An object is looked up as a file of its own first, then in the packs.
+class ObjectStore {
+public:
+    // Where the bytes of an object are: a file of its own, or a slice of a pack
+    struct Location {
+        std::string file;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        bool operator==(const Location& other) const;
+    };
+    // What collect did
+    struct Collection {
+        size_t objectsRemoved = 0;
+        uint64_t bytesReclaimed = 0;
+        size_t objectsPacked = 0;
+        size_t packsWritten = 0;
+        size_t packsRemoved = 0;
+        bool finished = true; // False when the budget ran out with work left
+    };
+    // Where a block of a blocked object lies, so it can be decompressed without the others
+    struct Block {
+        uint64_t offset = 0;   // Of its first byte in the content
+        uint64_t position = 0; // Of its stored bytes in the object's file
+        uint32_t rawSize = 0;
+        uint32_t storedSize = 0;
+        uint8_t codec = 0;
+    };
+    // Blocks of an object. Objects stored as deltas or as a single zlib stream have none
+    // and are only rebuilt whole; `size` is then unknown until they are read.
+    struct Layout {
+        bool blocked = false;
+        uint64_t size = 0;
+        Location location; // Which repack and collect may change
+        std::vector<Block> blocks;
+    };
+
+    ObjectStore(const std::string& objectsPath);
+    // Returns the object id of the stored content. With a base object, the content
+    // is stored as a delta against it when that is smaller than compressing it whole.
+    std::string store(const std::string& filepath, const std::string& baseId = "");
+    void restore(const std::string& objectId, const std::string& destPath);
+    void read(const std::string& objectId, const std::function<void(const char*, size_t)>& sink);
+    bool contains(const std::string& objectId);
+    Layout layout(const std::string& objectId); // Reads only the block headers
+    std::string readBlock(const std::string& objectId, const Layout& layout, size_t index);
+    std::string objectPath(const std::string& objectId); // File of a loose object, whether it exists or not
+    Location locate(const std::string& objectId);        // Throws if the object is missing
+    std::string fileOf(const std::string& objectId);     // Its own file or its pack, to flush it
+    // Rewrite the given objects as delta chains. Each history lists the objects of
+    // one path from oldest to newest; every object becomes a delta against its
+    // predecessor in the first history it appears in, or a full keyframe. Packed
+    // objects, and the loose bases of packed deltas, are left as they are.
+    void repack(const std::vector<std::vector<std::string>>& histories);
+    // Delete the objects that are neither `referenced` nor the base of a delta that is,
+    // and gather small loose objects, with the live objects of mostly dead packs, into
+    // a new pack. Packing stops after about `budget` bytes; call again until finished.
+    Collection collect(const std::set<std::string>& referenced, uint64_t budget);
+    // Blocks of large files are compressed on `pool` when set; store may then be called from several threads
+    void setThreadPool(ThreadPool* pool);
+    CompressionPolicy& compression();
+private:
+    std::string basePath;
+    CompressionPolicy policy;
+    ThreadPool* pool = nullptr;
+    std::atomic<unsigned> blocksInFlight{0}; // Blocks being compressed on the pool, across all objects
+    std::mutex deltaMutex;
+    std::condition_variable deltaRoom;
+    uint64_t deltaBytes = 0; // Memory held by the delta encodes running, across all threads
+    std::mutex packMutex; // Guards the pack index, looked up by stores on several threads
+    bool packsLoaded = false;
+    std::map<std::string, Location> packed; // Objects in packs, by id
+    std::string packPath();
+    void loadPacks(); // Called with packMutex held
+    bool findPacked(const std::string& objectId, Location& location, bool reload);
+    std::ifstream open(const std::string& objectId, Location& location); // Positioned at the object's first byte
+    std::string baseOf(const std::string& objectId); // Base of a delta, empty for a whole object
+    std::string baseAt(const std::string& objectId, const Location& location); // Of the copy at `location`
+    void writePack(const std::vector<std::pair<std::string, Location>>& sources, Collection& result);
+    std::string temporaryPath();
+    std::string load(const std::string& objectId); // Content of an object, rebuilt from its deltas
+    unsigned chainDepth(const std::string& objectId); // Number of deltas to apply to rebuild it
+    bool storeDelta(const std::string& objectId, const std::string& content, const std::string& baseId,
+                    uintmax_t sizeLimit);
+    void storeFull(const std::string& objectId, const std::string& content);
+    void install(const std::string& tempPath, const std::string& objectId);
+};
+
+#endif // OBJECT_STORE_H
@@ -0,0 +1,152 @@
+#include "PathIndex.h"
+#include <vector>
+
+namespace {
+
+bool isSeparator(char c) {
+#ifdef _WIN32
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+}
+
+// Components of a path; "a/b", "a//b" and "a/b/" have the same ones, and a leading
+// separator is a component of its own so "/a" and "a" differ
+std::vector<std::string> componentsOf(const std::string& path) {
+    std::vector<std::string> components;
+    if (!path.empty() && isSeparator(path[0])) {
+        components.emplace_back(1, '/');
+    }
+    size_t start = 0;
+    while (start < path.size()) {
+        size_t end = start;
+        while (end < path.size() && !isSeparator(path[end])) {
+            end++;
+        }
+        if (end > start) {
+            components.push_back(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return components;
+}
+
+}
+
+// Constructor
+PathIndex::PathIndex()
+    : root(std::make_unique<Node>()) {
+}
+
+PathIndex::~PathIndex() = default;
+
+void PathIndex::clear() {
+    root = std::make_unique<Node>();
+    count = 0;
+}
+
+size_t PathIndex::size() const {
+    return count;
+}
+
+void PathIndex::insert(const std::string& path, size_t position) {
+    std::vector<Node*> ancestors;
+    Node* node = root.get();
+    for (const std::string& component : componentsOf(path)) {
+        ancestors.push_back(node);
+        std::unique_ptr<Node>& child = node->children[component];
+        if (!child) {
+            child = std::make_unique<Node>();
+        }
+        node = child.get();
+    }
+    node->position = position;
+    if (node->tracked) {
+        return;
+    }
+    node->tracked = true;
+    node->path = path;
+    for (Node* ancestor : ancestors) {
+        ancestor->trackedBelow++;
+    }
+    count++;
+}
+
+bool PathIndex::erase(const std::string& path) {
+    std::vector<std::pair<Node*, std::string>> ancestors;
+    Node* node = root.get();
+    for (const std::string& component : componentsOf(path)) {
+        auto it = node->children.find(component);
+        if (it == node->children.end()) {
+            return false;
+        }
+        ancestors.emplace_back(node, component);
+        node = it->second.get();
+    }
+    if (!node->tracked) {
+        return false;
+    }
+    node->tracked = false;
+    node->path.clear();
+    count--;
+
+    // Drop the nodes that no longer lead to a tracked path, deepest first
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+        Node* parent = it->first;
+        parent->trackedBelow--;
+        Node* child = parent->children[it->second].get();
+        if (!child->tracked && child->trackedBelow == 0) {
+            parent->children.erase(it->second);
+        }
+    }
+    return true;
+}
+
+const PathIndex::Node* PathIndex::findNode(const std::string& path) const {
+    const Node* node = root.get();
+    for (const std::string& component : componentsOf(path)) {
+        auto it = node->children.find(component);
+        if (it == node->children.end()) {
+            return nullptr;
+        }
+        node = it->second.get();
+    }
+    return node;
+}
+
+bool PathIndex::find(const std::string& path, size_t& position) const {
+    const Node* node = findNode(path);
+    if (!node || !node->tracked) {
+        return false;
+    }
+    position = node->position;
+    return true;
+}
+
+std::string PathIndex::trackedAncestor(const std::string& path) const {
+    const Node* node = root.get();
+    for (const std::string& component : componentsOf(path)) {
+        auto it = node->children.find(component);
+        if (it == node->children.end()) {
+            return "";
+        }
+        node = it->second.get();
+        if (node->tracked) {
+            return node->path;
+        }
+    }
+    return "";
+}
+
+std::string PathIndex::trackedDescendant(const std::string& folder) const {
+    const Node* node = findNode(folder);
+    if (!node || node->trackedBelow == 0) {
+        return "";
+    }
+    // Every node kept in the trie leads to a tracked path
+    do {
+        node = node->children.begin()->second.get();
+    } while (!node->tracked);
+    return node->path;
+}
@@ -0,0 +1,43 @@
+#ifndef PATH_INDEX_H
+#define PATH_INDEX_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Tracked paths arranged as a trie of path components, each tracked path holding
+// the position of its record. Finding a path, its tracked ancestors or any
+// tracked path below it walks one node per component, so conflict checks cost
+// O(path length) however many paths are tracked.
+class PathIndex {
+public:
+    PathIndex();
+    ~PathIndex();
+
+    void clear();
+    size_t size() const;
+    void insert(const std::string& path, size_t position); // Updates the position of a path already present
+    bool erase(const std::string& path);
+    bool find(const std::string& path, size_t& position) const;
+
+    // The path itself or its closest tracked ancestor, empty if there is none
+    std::string trackedAncestor(const std::string& path) const;
+    // Some tracked path strictly below `folder`, empty if there is none
+    std::string trackedDescendant(const std::string& folder) const;
+private:
+    struct Node {
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+        std::string path;     // Tracked path ending here, as it was inserted
+        bool tracked = false;
+        size_t position = 0;
+        size_t trackedBelow = 0; // Tracked paths strictly below this node
+    };
+
+    std::unique_ptr<Node> root;
+    size_t count = 0;
+
+    const Node* findNode(const std::string& path) const;
+};
+
+#endif // PATH_INDEX_H
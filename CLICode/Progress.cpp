@@ -0,0 +1,73 @@
+#include "Progress.h"
+
+// Constructor
+Progress::Progress()
+    : start(std::chrono::steady_clock::now()) {
+}
+
+void Progress::setListener(Listener listener, std::chrono::milliseconds interval) {
+    this->listener = std::move(listener);
+    intervalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+}
+
+void Progress::addWork(size_t files, uintmax_t bytes) {
+    filesTotal += files;
+    bytesTotal += bytes;
+}
+
+// Count finished work, and report it if the last report is old enough. Only the
+// thread that moves the report time forward reports, so reports never pile up.
+void Progress::advance(size_t files, uintmax_t bytes) {
+    filesDone += files;
+    bytesDone += bytes;
+    if (!listener) {
+        return;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    int64_t last = lastReportNs;
+    if (now - last >= intervalNs && lastReportNs.compare_exchange_strong(last, now)) {
+        listener(snapshot());
+    }
+}
+
+void Progress::report() {
+    if (listener) {
+        listener(snapshot());
+    }
+}
+
+// The remaining time assumes the rest goes at the average rate so far, by bytes
+// when the operation knows them and by files otherwise
+Progress::Snapshot Progress::snapshot() const {
+    Snapshot snapshot;
+    snapshot.filesDone = filesDone;
+    snapshot.filesTotal = filesTotal;
+    snapshot.bytesDone = bytesDone;
+    snapshot.bytesTotal = bytesTotal;
+    snapshot.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double fraction = 0;
+    if (snapshot.bytesTotal > 0) {
+        fraction = static_cast<double>(snapshot.bytesDone) / snapshot.bytesTotal;
+    } else if (snapshot.filesTotal > 0) {
+        fraction = static_cast<double>(snapshot.filesDone) / snapshot.filesTotal;
+    }
+    if (fraction > 0) {
+        snapshot.remainingSeconds = fraction < 1 ? snapshot.elapsedSeconds * (1 - fraction) / fraction : 0;
+    }
+    return snapshot;
+}
+
+void Progress::cancel() {
+    cancelled = true;
+}
+
+bool Progress::isCancelled() const {
+    return cancelled;
+}
+
+void Progress::checkCancelled() const {
+    if (cancelled) {
+        throw OperationCancelled();
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
+// Thrown by an operation that stops because its Progress was cancelled
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("Operation cancelled.") {}
+};
+
+// Files and bytes done by a running operation, out of what it has found so far.
+// Updated from any thread, including the pool's workers; totals grow while the
+// operation discovers its work, so the estimate improves as it goes.
+class Progress {
+public:
+    struct Snapshot {
+        size_t filesDone = 0;
+        size_t filesTotal = 0;
+        uintmax_t bytesDone = 0;
+        uintmax_t bytesTotal = 0;
+        double elapsedSeconds = 0;
+        double remainingSeconds = -1; // Unknown until some work is done
+    };
+    using Listener = std::function<void(const Snapshot&)>;
+
+    Progress();
+    // Called with a snapshot at most every `interval`, on the thread reporting the work.
+    // Set before the operation starts.
+    void setListener(Listener listener, std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    void addWork(size_t files, uintmax_t bytes);
+    void advance(size_t files, uintmax_t bytes);
+    void report(); // Call the listener now
+    Snapshot snapshot() const;
+
+    void cancel();
+    bool isCancelled() const;
+    void checkCancelled() const; // Throws OperationCancelled once cancelled
+private:
+    std::chrono::steady_clock::time_point start;
+    std::atomic<size_t> filesDone{0};
+    std::atomic<size_t> filesTotal{0};
+    std::atomic<uintmax_t> bytesDone{0};
+    std::atomic<uintmax_t> bytesTotal{0};
+    std::atomic<bool> cancelled{false};
+    Listener listener;
+    int64_t intervalNs = 0;
+    std::atomic<int64_t> lastReportNs{0}; // Since `start`
+};
+
+#endif // PROGRESS_H
@@ -0,0 +1,264 @@
+#include "RecordIndex.h"
+#include "Digest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'Z', 'R', 'I', '1'};
+const uint32_t FORMAT_VERSION = 1;
+const size_t HEADER_SIZE = 40;
+const size_t ROW_FIXED_SIZE = 16; // Path offset, path length and flags
+const uint32_t HAS_OLD_HASH = 1;
+const uint32_t HAS_NEW_HASH = 2;
+
+uint64_t readLE(const unsigned char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+void appendLE(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+uint64_t checksumOf(const unsigned char* p, size_t size) {
+    std::unique_ptr<Digest> hasher = Digest::create(Digest::Fast);
+    hasher->update(reinterpret_cast<const char*>(p), size);
+    return std::strtoull(hasher->hexDigest().c_str(), nullptr, 16);
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Raw bytes of a hex digest, appended to `out`
+void appendDigest(std::string& out, const std::string& digest, uint32_t width) {
+    if (digest.empty()) {
+        out.append(width, '\0');
+        return;
+    }
+    for (size_t i = 0; i < digest.size(); i += 2) {
+        int high = hexValue(digest[i]), low = hexValue(digest[i + 1]);
+        if (high < 0 || low < 0) {
+            throw std::runtime_error("Record digest is not hexadecimal: " + digest);
+        }
+        out.push_back(static_cast<char>(high * 16 + low));
+    }
+}
+
+std::string hexOf(const unsigned char* p, uint32_t width) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(width * 2);
+    for (uint32_t i = 0; i < width; i++) {
+        hex.push_back(digits[p[i] >> 4]);
+        hex.push_back(digits[p[i] & 0xf]);
+    }
+    return hex;
+}
+
+}
+
+// Constructor
+RecordIndex::RecordIndex(const std::string& indexPath)
+    : indexPath(indexPath) {
+}
+
+RecordIndex::~RecordIndex() {
+    close();
+}
+
+bool RecordIndex::open() {
+    close();
+    if (!std::filesystem::exists(indexPath)) {
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        throw std::runtime_error("Failed to open record index: " + indexPath);
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    HANDLE mapping = length > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map record index: " + indexPath);
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const unsigned char*>(view);
+#else
+    int fd = ::open(indexPath.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Failed to open record index: " + indexPath);
+    }
+    length = static_cast<size_t>(st.st_size);
+    void* view = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd); // The mapping stays valid without the descriptor
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Failed to map record index: " + indexPath);
+    }
+    data = static_cast<const unsigned char*>(view);
+#endif
+
+    // A damaged index must not be mistaken for a repository without records
+    if (length < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        close();
+        throw std::runtime_error("Not a record index: " + indexPath);
+    }
+    if (readLE(data + 4, 4) != FORMAT_VERSION) {
+        close();
+        throw std::runtime_error("Unsupported record index version: " + indexPath);
+    }
+    count = readLE(data + 8, 8);
+    digestWidth = static_cast<uint32_t>(readLE(data + 16, 4));
+    uint64_t stringsSize = readLE(data + 24, 8);
+    uint64_t rowSize = ROW_FIXED_SIZE + 2 * uint64_t(digestWidth);
+    if (digestWidth > 64 || count > length / rowSize || HEADER_SIZE + count * rowSize + stringsSize != length ||
+        checksumOf(data + HEADER_SIZE, length - HEADER_SIZE) != readLE(data + 32, 8)) {
+        close();
+        throw std::runtime_error("Record index is corrupted: " + indexPath);
+    }
+    return true;
+}
+
+void RecordIndex::close() {
+    if (data) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        fileHandle = mappingHandle = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(data), length);
+#endif
+    }
+    data = nullptr;
+    length = 0;
+    count = 0;
+    digestWidth = 0;
+}
+
+size_t RecordIndex::size() const {
+    return static_cast<size_t>(count);
+}
+
+const unsigned char* RecordIndex::row(size_t index) const {
+    return data + HEADER_SIZE + index * (ROW_FIXED_SIZE + 2 * size_t(digestWidth));
+}
+
+std::string RecordIndex::pathOf(const unsigned char* row) const {
+    size_t stringsStart = HEADER_SIZE + static_cast<size_t>(count) * (ROW_FIXED_SIZE + 2 * size_t(digestWidth));
+    uint64_t offset = readLE(row, 8), pathLength = readLE(row + 8, 4);
+    if (offset + pathLength > length - stringsStart) {
+        throw std::runtime_error("Record index is corrupted: " + indexPath);
+    }
+    return std::string(reinterpret_cast<const char*>(data + stringsStart + offset), pathLength);
+}
+
+FileRecord RecordIndex::record(size_t index) const {
+    const unsigned char* r = row(index);
+    uint32_t flags = static_cast<uint32_t>(readLE(r + 12, 4));
+    FileRecord record;
+    record.filename = pathOf(r);
+    record.oldHash = flags & HAS_OLD_HASH ? hexOf(r + ROW_FIXED_SIZE, digestWidth) : "";
+    record.newHash = flags & HAS_NEW_HASH ? hexOf(r + ROW_FIXED_SIZE + digestWidth, digestWidth) : "";
+    return record;
+}
+
+void RecordIndex::write(const std::vector<FileRecord>& records) {
+    if (data) {
+        throw std::runtime_error("Record index is still mapped: " + indexPath);
+    }
+    std::string tempPath = indexPath + ".tmp";
+    writeTo(records, tempPath);
+    std::filesystem::rename(tempPath, indexPath);
+}
+
+const std::string& RecordIndex::path() const {
+    return indexPath;
+}
+
+void RecordIndex::writeTo(const std::vector<FileRecord>& records, const std::string& path) const {
+
+    // Every digest of a repository comes from the same algorithm, hence has the same width
+    size_t hexWidth = 0;
+    for (const auto& record : records) {
+        for (const std::string* digest : {&record.oldHash, &record.newHash}) {
+            if (digest->empty()) continue;
+            if ((hexWidth != 0 && digest->size() != hexWidth) || digest->size() % 2 != 0 || digest->size() > 128) {
+                throw std::runtime_error("Record digests have inconsistent lengths: " + record.filename);
+            }
+            hexWidth = digest->size();
+        }
+    }
+    uint32_t width = static_cast<uint32_t>(hexWidth / 2);
+
+    std::vector<size_t> order(records.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&records](size_t a, size_t b) { return records[a].filename < records[b].filename; });
+
+    std::string rows, strings;
+    rows.reserve(records.size() * (ROW_FIXED_SIZE + 2 * width));
+    for (size_t i : order) {
+        const FileRecord& record = records[i];
+        uint32_t flags = (record.oldHash.empty() ? 0 : HAS_OLD_HASH) | (record.newHash.empty() ? 0 : HAS_NEW_HASH);
+        appendLE(rows, strings.size(), 8);
+        appendLE(rows, record.filename.size(), 4);
+        appendLE(rows, flags, 4);
+        appendDigest(rows, record.oldHash, width);
+        appendDigest(rows, record.newHash, width);
+        strings += record.filename;
+    }
+    std::string body = rows + strings;
+
+    std::string header(MAGIC, sizeof(MAGIC));
+    appendLE(header, FORMAT_VERSION, 4);
+    appendLE(header, records.size(), 8);
+    appendLE(header, width, 4);
+    appendLE(header, 0, 4);
+    appendLE(header, strings.size(), 8);
+    appendLE(header, checksumOf(reinterpret_cast<const unsigned char*>(body.data()), body.size()), 8);
+
+    std::ofstream indexFile(path, std::ios::binary);
+    if (!indexFile.is_open()) {
+        throw std::runtime_error("Failed to open record index for writing.");
+    }
+    indexFile.write(header.data(), header.size());
+    indexFile.write(body.data(), body.size());
+    indexFile.close();
+    if (!indexFile) {
+        throw std::runtime_error("Failed to write record index.");
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef RECORD_INDEX_H
+#define RECORD_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Structure to represent a file record in the repository
+struct FileRecord {
+    std::string filename;
+    std::string oldHash;
+    std::string newHash;
+};
+
+// Binary store of the file records, memory-mapped for reading.
+//
+// Layout (integers little-endian):
+//   header  magic "ZRI1", format version (u32), record count (u64),
+//           digest width in bytes (u32), reserved (u32), string table size (u64),
+//           XXH64 checksum of everything after the header (u64)
+//   rows    one per record, sorted by path: path offset (u64), path length (u32),
+//           flags (u32), old digest and new digest (digest width bytes each)
+//   strings the paths, back to back
+// Digests are stored as raw bytes rather than hex; a flag marks an empty one.
+// Rows have a fixed width, so records are decoded straight from the mapping,
+// without parsing text, and the file is checked once as a whole.
+class RecordIndex {
+public:
+    RecordIndex(const std::string& indexPath);
+    ~RecordIndex();
+    RecordIndex(const RecordIndex&) = delete;
+    RecordIndex& operator=(const RecordIndex&) = delete;
+
+    bool open(); // Map the index and check its header and checksum; false if there is none
+    void close();
+    size_t size() const;
+    FileRecord record(size_t index) const;
+
+    // Replace the index with `records`, through a temporary file. Must not be mapped.
+    void write(const std::vector<FileRecord>& records);
+    // Write `records` in the index format to another file, such as one staged in a journal
+    void writeTo(const std::vector<FileRecord>& records, const std::string& path) const;
+    const std::string& path() const;
+private:
+    std::string indexPath;
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+    uint64_t count = 0;
+    uint32_t digestWidth = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    const unsigned char* row(size_t index) const;
+    std::string pathOf(const unsigned char* row) const;
+};
+
+#endif // RECORD_INDEX_H
@@ -1,29 +1,70 @@
 #include "Repository.h"
 #include "FileHandler.h"
+#include "Trace.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
 #include <minizip/zip.h>
 #include <minizip/unzip.h>
-#include "FileHandler.h"
+
+namespace {
+
+// Version of the folder hash scheme, stored in digest.txt after the digest id
+const std::string FOLDER_HASH_FORMAT = "tree-1";
+// Legacy archive entries are extracted through a buffer of this size
+const size_t RESTORE_CHUNK_SIZE = 1024 * 1024;
+
+// Give a staged file the permissions of the file it replaces, so an executable stays executable
+void keepPermissions(const std::string& target, const std::string& stagedPath) {
+    std::error_code error;
+    std::filesystem::file_status status = std::filesystem::status(target, error);
+    if (!error && std::filesystem::is_regular_file(status)) {
+        std::filesystem::permissions(stagedPath, status.permissions());
+    }
+}
+
+// Author of commits until setAuthor is called
+std::string defaultAuthor() {
+    for (const char* variable : {"ZIM_VCS_AUTHOR", "USER", "USERNAME"}) {
+        if (const char* name = std::getenv(variable)) {
+            return name;
+        }
+    }
+    return "";
+}
+
+}
 
 // Constructor
 Repository::Repository(const std::string& repoPath)
-    : baseRepoPath(repoPath), csvFilePath(repoPath + "/version_control.csv"), versionFilePath(repoPath + "/version.txt") {
+    : baseRepoPath(repoPath), csvFilePath(repoPath + "/version_control.csv"), recordIndex(repoPath + "/version_control.idx"),
+      versionFilePath(repoPath + "/version.txt"),
+      digestFilePath(repoPath + "/digest.txt"), compressionFilePath(repoPath + "/history/compression.csv"),
+      tagsFilePath(repoPath + "/history/tags.csv"), objects(repoPath + "/history/objects"),
+      statCache(repoPath + "/history/stat_cache.csv"), currentTree(repoPath + "/history/tree.csv"),
+      baseTree(repoPath + "/history/tree_base.csv"), journal(repoPath),
+      commitLog(repoPath + "/history/commits.log"), commitBlockPath(repoPath + "/history/commit.block"),
+      author(defaultAuthor()) {
     initializeRepository(true);
 }
 
-// Initialize the repository by creating a CSV file
+// Initialize the repository by creating the record index
 void Repository::initializeRepository(bool how) {
     std::cerr << "Initializing repository at " << baseRepoPath << std::endl;
 
-    // Check if the CSV file already exists
     if(how){
-        if (std::filesystem::exists(csvFilePath)) {
-            std::cout << "CSV file already exists. Loading records." << std::endl;
-            loadRecords();
-        }
+        journal.recover(); // Before anything the last transaction may have changed is read
+        commitLog.appendFrom(commitBlockPath); // Of a commit that stopped right after committing
+        bool hasRecords = isRepository(baseRepoPath);
+        bool fromCsv = hasRecords && loadRecords();
         if(std::filesystem::exists(versionFilePath)){
             std::ifstream versionFile(versionFilePath);
             if (versionFile.is_open()) {
@@ -31,26 +72,44 @@ void Repository::initializeRepository(bool how) {
                 versionFile.close();
             }
         }
+        if (std::filesystem::exists(digestFilePath)) {
+            std::ifstream digestFile(digestFilePath);
+            std::string digestId, folderFormat;
+            digestFile >> digestId >> folderFormat;
+            digestAlgorithm = Digest::fromId(digestId);
+            statCache.load(digestAlgorithm);
+            currentTree.load();
+            baseTree.load();
+            if (folderFormat != FOLDER_HASH_FORMAT) {
+                migrateDigests(digestAlgorithm, true); // Folder hashes were concatenated file hashes
+            }
+        } else if (hasRecords) {
+            // Repositories created before digests were versioned hold std::hash
+            // values, or SHA-256 ones from the first streaming hasher
+            bool sha256 = !records.empty() && records.front().oldHash.size() == 64;
+            migrateDigests(sha256 ? Digest::Strong : Digest::Legacy, true);
+        }
+        if (fromCsv) {
+            // One-time conversion, once the hashes are current
+            saveRecords();
+            std::filesystem::remove(csvFilePath);
+            std::cout << "Converted version_control.csv to version_control.idx" << std::endl;
+        }
+        objects.compression().load(compressionFilePath);
     }
     else {
-        // If the CSV file doesn't exist, create it
-        std::ofstream csvFile(csvFilePath);
-        if (!csvFile.is_open()) {
-            std::cerr << "Failed to create or open .csv file at: " << csvFilePath << std::endl;
-            throw std::runtime_error("Failed to create .csv file in repository.");
-        }
-
-        // Write CSV header
-        csvFile << "filename,oldHash,newHash\n";
-        csvFile.close();
+        records.clear();
+        trackedPaths.clear();
+        saveRecords();
 
 
         version = 0; // Default to version 0 if file does not exist
         std::ofstream outVersionFile(versionFilePath);
         outVersionFile << version;
         outVersionFile.close();
+        saveDigestAlgorithm();
 
-        std::cout << "Repository initialized with .csv file at " << csvFilePath << std::endl;
+        std::cout << "Repository initialized at " << baseRepoPath << std::endl;
     }
 }
 
@@ -69,184 +128,1034 @@ int Repository::getVersion(){
 }
 
 
-void Repository::trackFile(const std::string& filename) {
-    // Check if the filename already exists in records
-    for (const auto& record : records) {
-        if (std::filesystem::path(filename).string().find(record.filename) == 0) {
-            throw std::runtime_error("File is part of an already tracked folder: " + record.filename);
+Digest::Algorithm Repository::getDigestAlgorithm(){
+    return digestAlgorithm;
+}
+
+
+// Switch the algorithm used for record hashes, re-hashing every record
+void Repository::setDigestAlgorithm(Digest::Algorithm algorithm){
+    Digest::Algorithm previous = digestAlgorithm;
+    digestAlgorithm = algorithm;
+    statCache.reset(algorithm);
+    migrateDigests(previous, false);
+}
+
+
+bool Repository::isReservedName(const std::string& name){
+    return name == "version_control.idx" || name == "version_control.idx.tmp" || name == "version_control.csv" ||
+           name == "version.txt" || name == "digest.txt" || name == "history";
+}
+
+
+// Whether `repoPath` holds records, in the index or in the CSV file of an older version
+bool Repository::isRepository(const std::string& repoPath){
+    return std::filesystem::exists(repoPath + "/version_control.idx") ||
+           std::filesystem::exists(repoPath + "/version_control.csv");
+}
+
+
+std::vector<std::string> Repository::metadataPaths(const std::string& repoPath){
+    return {repoPath + "/version_control.idx", repoPath + "/version_control.csv", repoPath + "/version.txt",
+            repoPath + "/digest.txt", repoPath + "/history/stat_cache.csv", repoPath + "/history/tree.csv",
+            repoPath + "/history/tree_base.csv", repoPath + "/history/compression.csv"};
+}
+
+
+void Repository::saveDigestAlgorithm() {
+    std::ofstream digestFile(digestFilePath);
+    if (!digestFile.is_open()) {
+        throw std::runtime_error("Failed to open or create digest file.");
+    }
+    digestFile << Digest::idOf(digestAlgorithm) << "\n" << FOLDER_HASH_FORMAT;
+    digestFile.close();
+}
+
+
+// Re-hash every record with the current algorithm and folder hash scheme. A record
+// stays up to date only if its content still matches the hash that was recorded
+// with `from`, and with concatenated file hashes for folders if `concatenatedFolders`.
+void Repository::migrateDigests(Digest::Algorithm from, bool concatenatedFolders) {
+    if (from != digestAlgorithm || concatenatedFolders) {
+        std::vector<FileRecord*> present;
+        std::vector<std::string> paths;
+        for (auto& record : records) {
+            if (std::filesystem::exists(record.filename)) {
+                present.push_back(&record);
+                paths.push_back(record.filename);
+            } else {
+                // Still modified, with a hash of the current algorithm's width
+                record.oldHash = "";
+                record.newHash = FileHandler::calculateHash("", digestAlgorithm);
+            }
         }
+        std::vector<std::string> previousHashes = calculateRecordHashes(paths, from, concatenatedFolders);
+        std::vector<std::string> currentHashes = calculateRecordHashes(paths, digestAlgorithm, false);
+        for (size_t i = 0; i < present.size(); i++) {
+            bool unchanged = previousHashes[i] == present[i]->oldHash;
+            present[i]->newHash = currentHashes[i];
+            present[i]->oldHash = unchanged ? currentHashes[i] : "";
+            if (unchanged) {
+                baseTree.copySubtree(currentTree, present[i]->filename);
+            } else {
+                baseTree.remove(present[i]->filename);
+            }
+        }
+        saveRecords();
+        statCache.save(true);
+        currentTree.save();
+        baseTree.save();
     }
+    saveDigestAlgorithm();
+}
+
+
+void Repository::trackFile(const std::string& filename) {
+    trackMany({filename});
+}
+
 
-    // Filename doesn't exist, proceed to add it
-    std::cerr << "Filename is " << filename << std::endl;
-    std::string fileHash = calculateFileHash(filename);
-    records.push_back({filename, fileHash, fileHash});  // store the relative filename
+void Repository::trackFolder(const std::string& foldername) {
+    trackMany({foldername});
+}
+
+// Track several files and folders at once. Every path is checked for conflicts
+// before any is hashed, all of them are hashed in parallel, and the records are
+// saved once; if any path fails, none is added.
+void Repository::trackMany(const std::vector<std::string>& paths) {
+    Trace::Span span(Trace::Operation, "track");
+    // A path conflicts with itself and its tracked ancestors, a folder also with its tracked descendants.
+    // Accepted paths join the index right away so the batch is checked against itself too.
+    std::vector<bool> isFolder(paths.size());
+    size_t accepted = 0;
+    try {
+        for (; accepted < paths.size(); accepted++) {
+            const std::string& path = paths[accepted];
+            isFolder[accepted] = std::filesystem::is_directory(path);
+            std::string conflict = trackedPaths.trackedAncestor(path);
+            if (!isFolder[accepted] && !conflict.empty()) {
+                throw std::runtime_error("File is part of an already tracked folder: " + conflict);
+            }
+            if (isFolder[accepted] && (!conflict.empty() || !(conflict = trackedPaths.trackedDescendant(path)).empty())) {
+                throw std::runtime_error("Folder conflicts with an already tracked file or folder: " + conflict);
+            }
+            trackedPaths.insert(path, records.size() + accepted);
+        }
+        for (size_t i = 0; i < paths.size() && Trace::verbose(); i++) {
+            std::cerr << (isFolder[i] ? "Foldername is " : "Filename is ") << paths[i] << std::endl;
+        }
+        std::vector<std::string> hashes = calculateRecordHashes(paths, digestAlgorithm, false);
+        for (size_t i = 0; i < paths.size(); i++) {
+            records.push_back({paths[i], hashes[i], hashes[i]});  // store the relative filename
+            if (isFolder[i]) {
+                baseTree.copySubtree(currentTree, paths[i]);
+            }
+        }
+    } catch (...) {
+        for (size_t i = 0; i < accepted; i++) {
+            trackedPaths.erase(paths[i]);
+        }
+        throw;
+    }
     saveRecords();
+    statCache.save(false);
+    currentTree.save();
+    baseTree.save();
 }
 
+std::string Repository::calculateFolderHash(const std::string& foldername, Digest::Algorithm algorithm) {
+    return calculateRecordHashes({foldername}, algorithm, false).front();
+}
 
 
-void Repository::trackFolder(const std::string& foldername) {
-    // Check if the foldername already exists in records
-    for (const auto& record : records) {
-        if (std::filesystem::path(foldername).string().find(record.filename) == 0 ||
-            std::filesystem::path(record.filename).string().find(foldername) == 0) {
-            throw std::runtime_error("Folder conflicts with an already tracked file or folder: " + record.filename);
+// Hash of each tracked file or folder in `paths`. Folders are walked on the calling
+// thread while the pool hashes the files found so far. A folder's hash is the root
+// of its Merkle tree (see MerkleTree), or with `concatenatedFolders` the hash of its
+// file hashes in walk order as older versions computed it.
+std::vector<std::string> Repository::calculateRecordHashes(const std::vector<std::string>& paths, Digest::Algorithm algorithm,
+                                                           bool concatenatedFolders) {
+    std::vector<std::vector<std::string>> filePaths(paths.size());
+    std::vector<std::vector<std::future<std::string>>> fileHashes(paths.size());
+    std::vector<bool> isFolder(paths.size());
+    ThreadPool& pool = workers();
+    auto hashLater = [&](size_t index, const std::string& filepath, uintmax_t size) {
+        progress->checkCancelled();
+        progress->addWork(1, size);
+        filePaths[index].push_back(filepath);
+        fileHashes[index].push_back(pool.submit([this, filepath, algorithm, size]() {
+            progress->checkCancelled();
+            std::string hash = calculateFileHash(filepath, algorithm);
+            progress->advance(1, size);
+            return hash;
+        }));
+    };
+
+    std::exception_ptr failure;
+    try {
+        for (size_t i = 0; i < paths.size(); i++) {
+            isFolder[i] = std::filesystem::is_directory(paths[i]);
+            if (!isFolder[i]) {
+                std::error_code error; // A missing file fails when hashed, with its own message
+                uintmax_t size = std::filesystem::file_size(paths[i], error);
+                hashLater(i, paths[i], error ? 0 : size);
+                continue;
+            }
+            Trace::Span walk(Trace::Walk, "walk", paths[i]);
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(paths[i])) {
+                if (entry.is_regular_file()) {
+                    hashLater(i, entry.path().string(), entry.file_size());
+                }
+            }
         }
+    } catch (...) {
+        failure = std::current_exception();
     }
 
-    // Foldername doesn't exist, proceed to add it
-    std::cerr << "Foldername is " << foldername << std::endl;
+    // Every task is waited for, even after a failure, since they all use this repository
+    std::vector<std::vector<std::pair<std::string, std::string>>> fileDigests(paths.size());
+    for (size_t i = 0; i < fileHashes.size(); i++) {
+        for (size_t j = 0; j < fileHashes[i].size(); j++) {
+            try {
+                fileDigests[i].emplace_back(filePaths[i][j], fileHashes[i][j].get());
+            } catch (...) {
+                if (!failure) failure = std::current_exception();
+            }
+        }
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
 
-    // Create a hash for the folder based on its contents
-    std::string folderHash = calculateFolderHash(foldername);
-    records.push_back({foldername, folderHash, folderHash});  // store the relative foldername
-    saveRecords();
+    // Trees of another algorithm are only needed for their root
+    MerkleTree scratchTree("");
+    MerkleTree& tree = algorithm == digestAlgorithm ? currentTree : scratchTree;
+    std::vector<std::string> hashes(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!isFolder[i]) {
+            hashes[i] = fileDigests[i].front().second;
+        } else if (concatenatedFolders) {
+            std::string combinedHashes;
+            for (const auto& fileDigest : fileDigests[i]) {
+                combinedHashes += fileDigest.second;
+            }
+            hashes[i] = FileHandler::calculateHash(combinedHashes, algorithm);
+        } else {
+            hashes[i] = tree.update(paths[i], fileDigests[i], algorithm);
+        }
+    }
+    return hashes;
 }
 
-std::string Repository::calculateFolderHash(const std::string& foldername) {
-    std::string combinedHashes;
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(foldername)) {
-        if (entry.is_regular_file()) {
-            std::string fileHash = calculateFileHash(entry.path().string());
-            combinedHashes += fileHash; // Concatenate all file hashes (or combine them in a more sophisticated way)
-        }
+
+ThreadPool& Repository::workers() {
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(workerCount);
     }
-    return FileHandler::calculateHash(combinedHashes); // Use the same hash function to hash the combined hashes
+    return *pool;
 }
 
 
+void Repository::setProgress(Progress* progress) {
+    this->progress = progress ? progress : &idle;
+}
+
+
+// Number of threads hashing files, takes effect on the next operation
+void Repository::setWorkerCount(unsigned count) {
+    workerCount = count > 0 ? count : ThreadPool::defaultWorkerCount();
+    pool.reset();
+}
+
 
-bool Repository::update() {
-    bool hasChanged = false;
 
-    for (auto& record : records) {
-        std::string newHash;
+void Repository::watch(FileWatcher::Listener listener) {
+    if (!watcher) {
+        watcher = std::make_unique<FileWatcher>(baseRepoPath, std::move(listener));
+    }
+}
 
-        // Check if the record is a file or a directory
-        if (std::filesystem::is_directory(record.filename)) {
-            newHash = calculateFolderHash(record.filename);  // Use the folder hash function
+
+// Refresh the new hash of every record. With a watcher, only the records with
+// changes under them are looked at, unless it lost track and asks for a rescan.
+bool Repository::update() {
+    Trace::Span span(Trace::Operation, "update");
+    bool rescan = true;
+    std::vector<std::string> changedPaths;
+    if (watcher) {
+        changedPaths = watcher->takeChanges(rescan);
+        // Changes are matched to records by path, so records given another way round are rescanned
+        std::string prefix = watcher->rootPath() + "/";
+        rescan = rescan || std::any_of(records.begin(), records.end(),
+                                       [&](const FileRecord& record) { return record.filename.rfind(prefix, 0) != 0; });
+    }
+    std::vector<std::string> previousHashes;
+    previousHashes.reserve(records.size());
+    for (const auto& record : records) {
+        previousHashes.push_back(record.newHash);
+    }
+    try {
+        if (rescan) {
+            std::vector<std::string> hashes = calculateRecordHashes(getFiles(), digestAlgorithm, false);
+            for (size_t i = 0; i < records.size(); i++) {
+                records[i].newHash = hashes[i];  // Update the new hash
+            }
         } else {
-            newHash = calculateFileHash(record.filename);  // Use the file hash function
+            updateChanged(changedPaths);
         }
+    } catch (...) {
+        if (watcher) watcher->requestRescan(); // The taken changes were not all applied
+        throw;
+    }
 
-        // Check if the hash has changed
-        if (newHash != record.oldHash) {
+    bool hasChanged = false, refreshed = false;
+    for (size_t i = 0; i < records.size(); i++) {
+        // Check if the hash differs from the last commit, and whether this refresh changed it
+        if (records[i].newHash != records[i].oldHash) {
             hasChanged = true;
         }
-        record.newHash = newHash;  // Update the new hash
+        if (records[i].newHash != previousHashes[i]) {
+            refreshed = true;
+        }
     }
 
-    if (hasChanged) {
+    // Rewriting an unchanged index would only wake up the watchers of the repository again
+    if (refreshed) {
         saveRecords();
     }
+    statCache.save(rescan); // After a rescan every tracked file was visited, the others can be forgotten
+    currentTree.save();
     return hasChanged;
 }
 
+
+// Rehash the records that `changedPaths` belong to. A changed file record, or a
+// folder record that changed as a whole, is hashed again; inside a folder only the
+// changed paths are.
+void Repository::updateChanged(const std::vector<std::string>& changedPaths) {
+    std::map<size_t, std::vector<std::string>> touched; // Changed paths by record position
+    for (const std::string& path : changedPaths) {
+        std::string recordPath = trackedPaths.trackedAncestor(path);
+        size_t position;
+        if (!recordPath.empty() && trackedPaths.find(recordPath, position)) {
+            touched[position].push_back(path);
+        }
+    }
+
+    std::vector<std::string> whole;
+    std::vector<size_t> wholePositions;
+    for (const auto& [position, paths] : touched) {
+        FileRecord& record = records[position];
+        std::string recordKey = MerkleTree::keyOf(record.filename);
+        bool itself = std::any_of(paths.begin(), paths.end(),
+                                  [&](const std::string& path) { return MerkleTree::keyOf(path) == recordKey; });
+        if (itself || !currentTree.contains(record.filename)) {
+            whole.push_back(record.filename);
+            wholePositions.push_back(position);
+        } else {
+            record.newHash = updateFolderHash(record.filename, paths);
+        }
+    }
+    std::vector<std::string> hashes = calculateRecordHashes(whole, digestAlgorithm, false);
+    for (size_t i = 0; i < whole.size(); i++) {
+        records[wholePositions[i]].newHash = hashes[i];
+    }
+}
+
+
+// Merkle root of a tracked folder in which only `changedPaths` changed since its tree
+// was built. A changed path may have been a file or a folder, and may be one now, so
+// whatever the tree holds at or below it is replaced by what is on disk.
+std::string Repository::updateFolderHash(const std::string& foldername, const std::vector<std::string>& changedPaths) {
+    std::map<std::string, std::string> digests; // By tree key
+    for (const auto& [key, digest] : currentTree.files(foldername)) {
+        digests[key] = digest;
+    }
+
+    std::set<std::string> rehash;
+    for (const std::string& path : changedPaths) {
+        std::string key = MerkleTree::keyOf(path);
+        digests.erase(key);
+        for (auto it = digests.lower_bound(key + "/"); it != digests.end() && it->first.rfind(key + "/", 0) == 0;) {
+            it = digests.erase(it);
+        }
+        if (std::filesystem::is_regular_file(path)) {
+            rehash.insert(key);
+        } else if (std::filesystem::is_directory(path)) {
+            Trace::Span walk(Trace::Walk, "walk", path);
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    rehash.insert(MerkleTree::keyOf(entry.path().string()));
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> files(rehash.begin(), rehash.end());
+    std::vector<std::string> hashes = calculateRecordHashes(files, digestAlgorithm, false);
+    for (size_t i = 0; i < files.size(); i++) {
+        digests[files[i]] = hashes[i];
+    }
+    std::vector<std::pair<std::string, std::string>> fileDigests(digests.begin(), digests.end());
+    return currentTree.update(foldername, fileDigests, digestAlgorithm);
+}
+
 // Refresh record Statuses and return whether a file has been modified
 void Repository::updateCommit() {
+    Trace::Span span(Trace::Operation, "commit");
+    // After a rollback the commit replaces the version rolled back to; a tag only names a
+    // version number, so it would silently point at the new content
+    if (hasVersion(version)) {
+        for (const auto& [name, versionNumber] : tags()) {
+            if (versionNumber == version) {
+                throw std::runtime_error("Version " + std::to_string(version) + " is tagged " + name +
+                                         "; remove the tag before committing over it.");
+            }
+        }
+    }
     bool hasChanged = update();
-    std::cout << hasChanged << std::endl;
     if(!hasChanged) throw std::runtime_error("At least one file must be modified before committing.");
-    for (auto& record : records) {
-        record.oldHash = record.newHash;
-    }
 
     std::string historyPath = baseRepoPath + "/history";
     if (!std::filesystem::exists(historyPath)) {
         std::filesystem::create_directory(historyPath);
     }
-    // Code for compressing files
-    std::string versionedArchiveName = "commit_" + std::to_string(version) + ".zip";
-    compressFiles(getFiles(), historyPath + "/" + versionedArchiveName);
+
+    // Objects of the previous commit by path, reused for every file whose digest did not change
+    std::map<std::string, ManifestEntry> previous;
+    for (auto& entry : loadManifest(version - 1)) {
+        previous[entry.path] = entry;
+    }
+
+    // Changed files are stored on the pool, several at once, and the blocks of large
+    // ones are compressed in parallel too. The manifest keeps the order of the records.
+    ThreadPool& pool = workers();
+    objects.setThreadPool(&pool);
+    std::vector<ManifestEntry> manifest;
+    std::vector<std::pair<size_t, std::future<std::string>>> stores; // Manifest position and object id
+    size_t collected = 0;
+    std::exception_ptr failure;
+    auto collect = [&]() {
+        auto& [position, objectId] = stores[collected++];
+        try {
+            manifest[position].objectId = pool.wait(objectId);
+        } catch (...) {
+            if (!failure) failure = std::current_exception(); // Every store must be finished before leaving
+        }
+    };
+    size_t storedFiles = 0;
+    uintmax_t storedBytes = 0;
+    std::vector<FileChange> changes; // For the commit log
+    auto start = std::chrono::steady_clock::now();
+    try {
+        for (auto& record : records) {
+            for (const auto& [filepath, digest] : trackedFiles(record)) {
+                std::string path = relativePath(filepath);
+                auto it = previous.find(path);
+                if (it != previous.end() && it->second.digest == digest) {
+                    manifest.push_back(it->second);
+                } else {
+                    // Only changed files are read again, stored as deltas against their previous version
+                    std::string baseId = it != previous.end() ? it->second.objectId : "";
+                    std::string file = filepath;
+                    while (stores.size() - collected >= pool.size()) {
+                        collect(); // A few files at a time, so open files and buffers stay bounded
+                    }
+                    uintmax_t size = std::filesystem::file_size(filepath);
+                    progress->checkCancelled();
+                    progress->addWork(1, size);
+                    storedBytes += size;
+                    storedFiles++;
+                    changes.push_back({it != previous.end() ? FileChange::Modified : FileChange::Added, path,
+                                       it != previous.end() ? it->second.digest : "", digest, size});
+                    stores.emplace_back(manifest.size(), pool.submit([this, file, baseId, size]() {
+                        progress->checkCancelled();
+                        std::string objectId = objects.store(file, baseId);
+                        progress->advance(1, size);
+                        return objectId;
+                    }));
+                    manifest.push_back({path, "", digest});
+                }
+            }
+        }
+    } catch (...) {
+        if (!failure) failure = std::current_exception(); // Cancelled, or a file vanished; started stores still finish
+    }
+    while (collected < stores.size()) {
+        collect();
+    }
+    objects.setThreadPool(nullptr);
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+
+    // The manifest, version, records and committed tree are replaced together, once
+    // the objects they refer to are on disk
+    std::vector<FileRecord> committed = records;
+    for (auto& record : committed) {
+        record.oldHash = record.newHash;
+    }
+    std::set<std::string> kept;
+    for (const auto& entry : manifest) {
+        kept.insert(entry.path);
+    }
+    for (const auto& [path, entry] : previous) {
+        if (!kept.count(path)) {
+            changes.push_back({FileChange::Removed, path, entry.digest, "", 0});
+        }
+    }
+    try {
+        // The log only gets the block once the commit is durable: after a rollback, it would
+        // otherwise replace the block of the version on disk even if this commit fails
+        commitLog.writeBlock({version, version - 1, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count(),
+                              author, storedBytes, std::move(changes)},
+                             journal.stage(commitBlockPath));
+        for (const auto& store : stores) {
+            journal.requireDurable(objects.fileOf(manifest[store.first].objectId)); // Reused ones may be packed
+        }
+        saveManifest(journal.stage(manifestPath(version)), manifest);
+        saveVersion(journal.stage(versionFilePath), version + 1);
+        recordIndex.writeTo(committed, journal.stage(recordIndex.path()));
+        currentTree.saveTo(journal.stage(baseTree.path()));
+        journal.commit(&pool);
+    } catch (...) {
+        journal.abort();
+        throw;
+    }
+    records = std::move(committed);
+    baseTree.copyAll(currentTree);
+    try {
+        commitLog.appendFrom(commitBlockPath);
+    } catch (const std::exception& e) {
+        std::cerr << "The commit log is updated on next open: " << e.what() << std::endl; // The block stays staged
+    }
+    reportThroughput("Committed version " + std::to_string(version) + ": stored " + std::to_string(storedFiles) + " files",
+                     storedBytes, start);
     version++;
+}
 
-    std::ofstream versionFile(versionFilePath);
-    if (!versionFile.is_open()) {
-        throw std::runtime_error("Failed to open or create version file.");
+
+// Write every file of a version into a zip archive at `zipPath`. Entries are streamed
+// from the object store in bounded chunks and written as ZIP64, so files of any size
+// fit, and neither side is held in memory.
+void Repository::exportVersion(int versionNumber, const std::string& zipPath) {
+    Trace::Span span(Trace::Operation, "export");
+    std::string legacyArchive = baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip";
+    if (!std::filesystem::exists(manifestPath(versionNumber))) {
+        if (!std::filesystem::exists(legacyArchive)) {
+            throw std::runtime_error("Specified version does not exist.");
+        }
+        std::filesystem::copy_file(legacyArchive, zipPath, std::filesystem::copy_options::overwrite_existing);
+        return;
     }
-    versionFile << version;
-    versionFile.close();
 
-    saveRecords();
+    zipFile archive = zipOpen64(zipPath.c_str(), APPEND_STATUS_CREATE);
+    if (!archive) {
+        throw std::runtime_error("Could not create zip file: " + zipPath);
+    }
+    uintmax_t exportedBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        for (const auto& entry : loadManifest(versionNumber)) {
+            zip_fileinfo fileInfo = {};
+            if (zipOpenNewFileInZip64(archive, entry.path.c_str(), &fileInfo, NULL, 0, NULL, 0, NULL, Z_DEFLATED,
+                                      Z_DEFAULT_COMPRESSION, 1) != ZIP_OK) {
+                throw std::runtime_error("Could not add " + entry.path + " to zip file.");
+            }
+            objects.read(entry.objectId, [&](const char* data, size_t size) {
+                if (zipWriteInFileInZip(archive, data, static_cast<unsigned>(size)) != ZIP_OK) {
+                    throw std::runtime_error("Could not write " + entry.path + " to zip file.");
+                }
+                exportedBytes += size;
+            });
+            if (zipCloseFileInZip(archive) != ZIP_OK) {
+                throw std::runtime_error("Could not add " + entry.path + " to zip file.");
+            }
+        }
+    } catch (...) {
+        zipClose(archive, NULL);
+        std::filesystem::remove(zipPath);
+        throw;
+    }
+    if (zipClose(archive, NULL) != ZIP_OK) {
+        throw std::runtime_error("Could not finish zip file: " + zipPath);
+    }
+    reportThroughput("Exported version " + std::to_string(versionNumber) + " to " + zipPath, exportedBytes, start);
 }
 
 
-void Repository::compressFiles(const std::vector<std::string>& paths, const std::string& outputPath) {
-    namespace fs = std::filesystem;
-    zipFile zf = zipOpen(outputPath.c_str(), APPEND_STATUS_CREATE);
-    if (!zf) {
-        throw std::runtime_error("Failed to open output zip file.");
+// Change how files are compressed from the next commit on; objects already stored keep their encoding
+void Repository::setCompression(const std::string& extension, const std::string& codec, int level) {
+    objects.compression().set(extension, {CompressionPolicy::fromName(codec), level});
+    std::filesystem::create_directories(baseRepoPath + "/history");
+    objects.compression().save(compressionFilePath);
+}
+
+
+// Every committed version, oldest first. A version's time is that of its manifest
+// (or archive), which is written once when it is committed.
+std::vector<VersionInfo> Repository::versions() {
+    std::vector<VersionInfo> result;
+    for (int versionNumber : committedVersions()) {
+        VersionInfo info;
+        if (versionInfo(versionNumber, info)) {
+            result.push_back(std::move(info));
+        }
     }
+    attachTags(result);
+    return result;
+}
 
-    std::string baseFolderPath = baseRepoPath; // Get base folder path
+// The commit log's index finds the versions to describe; versions committed before
+// there was a log are compared with their parent instead
+std::vector<VersionInfo> Repository::history(const std::string& path) {
+    std::string key = selectionOf({path})[0];
+    if (key == ".") {
+        key.clear();
+    }
+    std::vector<int> committed = committedVersions();
+    std::vector<int> changed = commitLog.history(key, committed.empty() ? 0 : committed.back() + 1);
+    std::vector<VersionInfo> result;
+    for (int versionNumber : committed) {
+        bool logged = commitLog.contains(versionNumber);
+        if (logged && !std::binary_search(changed.begin(), changed.end(), versionNumber)) {
+            continue;
+        }
+        VersionInfo info;
+        if (!versionInfo(versionNumber, info)) {
+            continue;
+        }
+        bool touched = logged || std::any_of(info.changes.begin(), info.changes.end(), [&](const FileChange& change) {
+            return key.empty() || isSelected(change.path, {key});
+        });
+        if (touched) {
+            result.push_back(std::move(info));
+        }
+    }
+    attachTags(result);
+    return result;
+}
 
-    for (const auto& path : paths) {
-        if (fs::is_directory(path)) {
-            // Recursively add files from directory
-            for (const auto& entry : fs::recursive_directory_iterator(path)) {
-                if (entry.is_regular_file()) {
-                    addFileToZip(entry.path().string(), zf, baseFolderPath);
+// Whether a version is in history, below the version count or above it after a rollback
+bool Repository::hasVersion(int versionNumber) {
+    return versionNumber >= 0 &&
+           (std::filesystem::exists(manifestPath(versionNumber)) ||
+            std::filesystem::exists(baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip"));
+}
+
+// A rollback lowers the version count, but the versions above it stay in history until
+// commits overwrite them, as do versions after a gap left by collectGarbage
+std::vector<int> Repository::committedVersions() {
+    std::set<int> found;
+    std::string historyPath = baseRepoPath + "/history";
+    if (!std::filesystem::is_directory(historyPath)) {
+        return {};
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(historyPath)) {
+        std::string extension = entry.path().extension().string();
+        std::string stem = entry.path().stem().string();
+        if ((extension == ".manifest" || extension == ".zip") && stem.rfind("commit_", 0) == 0 && stem.size() > 7 &&
+            stem.size() <= 16 && std::all_of(stem.begin() + 7, stem.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            found.insert(std::stoi(stem.substr(7)));
+        }
+    }
+    return {found.begin(), found.end()};
+}
+
+bool Repository::versionInfo(int versionNumber, VersionInfo& info) {
+    info = VersionInfo();
+    info.version = versionNumber;
+    FileStat stat;
+    bool hasManifest = FileHandler::statFile(manifestPath(versionNumber), stat);
+    if (!hasManifest && !FileHandler::statFile(baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip", stat)) {
+        return false;
+    }
+    info.timeNs = stat.mtimeNs;
+    std::vector<ManifestEntry> manifest;
+    if (hasManifest) {
+        manifest = loadManifest(versionNumber);
+        info.files = manifest.size();
+    }
+
+    CommitInfo commit;
+    if (commitLog.find(versionNumber, commit)) {
+        info.parent = commit.parent;
+        info.timeNs = commit.timeNs;
+        info.author = commit.author;
+        info.bytesChanged = commit.bytesChanged;
+        info.changes = std::move(commit.changes);
+    } else if (hasManifest) {
+        // Committed before the log: sizes and authors are unknown
+        info.parent = versionNumber - 1;
+        std::map<std::string, std::string> parentDigests;
+        for (auto& entry : loadManifest(versionNumber - 1)) {
+            parentDigests[entry.path] = entry.digest;
+        }
+        for (const auto& entry : manifest) {
+            auto it = parentDigests.find(entry.path);
+            if (it == parentDigests.end()) {
+                info.changes.push_back({FileChange::Added, entry.path, "", entry.digest, 0});
+            } else {
+                if (it->second != entry.digest) {
+                    info.changes.push_back({FileChange::Modified, entry.path, it->second, entry.digest, 0});
+                }
+                parentDigests.erase(it);
+            }
+        }
+        for (const auto& [removed, digest] : parentDigests) {
+            info.changes.push_back({FileChange::Removed, removed, digest, "", 0});
+        }
+    }
+    return true;
+}
+
+// Compare a version with a later one, or with the working files. Files whose digests
+// (or, across digest algorithms, objects) match are skipped without being read; the
+// others are compared on the pool, streamed from the object store and the disk.
+std::vector<FileDiff> Repository::diff(int fromVersion, int toVersion, const std::vector<std::string>& paths) {
+    Trace::Span span(Trace::Operation, "diff");
+    std::vector<std::string> selection = selectionOf(paths);
+    struct Side {
+        std::string objectId; // Committed content
+        std::string digest;
+        std::string filepath; // Working file
+    };
+    auto sideOf = [&](int versionNumber) {
+        if (!hasVersion(versionNumber)) {
+            throw std::runtime_error("Specified version does not exist.");
+        }
+        if (!std::filesystem::exists(manifestPath(versionNumber))) {
+            throw std::runtime_error("Version " + std::to_string(versionNumber) +
+                                     " was committed as a zip archive by an older release and cannot be compared.");
+        }
+        std::map<std::string, Side> files;
+        for (auto& entry : loadManifest(versionNumber)) {
+            if (isSelected(entry.path, selection)) {
+                files[entry.path] = {entry.objectId, entry.digest, ""};
+            }
+        }
+        return files;
+    };
+
+    bool working = toVersion == WORKING_FILES;
+    std::map<std::string, Side> before = sideOf(fromVersion), after;
+    std::string beforeDigest = manifestDigestId(fromVersion), afterDigest;
+    if (working) {
+        update();
+        for (const auto& record : records) {
+            for (const auto& [filepath, digest] : trackedFiles(record)) {
+                std::string path = relativePath(filepath);
+                if (isSelected(path, selection) && std::filesystem::is_regular_file(filepath)) {
+                    after[path] = {"", digest, filepath};
                 }
             }
-        } else if (fs::is_regular_file(path)) {
-            // Add the file to the zip
-            addFileToZip(path, zf, baseFolderPath);
-        } else {
-            std::cerr << "Skipping non-regular file or directory: " << path << std::endl;
         }
+        afterDigest = Digest::idOf(digestAlgorithm);
+    } else {
+        after = sideOf(toVersion);
+        afterDigest = manifestDigestId(toVersion);
+    }
+    bool sameAlgorithm = !beforeDigest.empty() && beforeDigest == afterDigest;
+
+    auto sourceOf = [this](const Side& side) -> Diff::Source {
+        if (!side.filepath.empty()) {
+            std::string filepath = side.filepath;
+            return [filepath](const std::function<void(const char*, size_t)>& sink) { FileHandler::streamFile(filepath, sink); };
+        }
+        std::string objectId = side.objectId;
+        return [this, objectId](const std::function<void(const char*, size_t)>& sink) { objects.read(objectId, sink); };
+    };
+
+    std::set<std::string> allPaths;
+    for (const auto& [path, side] : before) allPaths.insert(path);
+    for (const auto& [path, side] : after) allPaths.insert(path);
+    ThreadPool& pool = workers();
+    std::vector<std::future<FileDiff>> compared;
+    for (const std::string& path : allPaths) {
+        auto old = before.find(path), current = after.find(path);
+        FileChange::Kind kind = old == before.end() ? FileChange::Added
+                                : current == after.end() ? FileChange::Removed : FileChange::Modified;
+        Side oldSide = old != before.end() ? old->second : Side(), newSide = current != after.end() ? current->second : Side();
+        if (kind == FileChange::Modified && ((sameAlgorithm && oldSide.digest == newSide.digest) ||
+                                             (!working && oldSide.objectId == newSide.objectId))) {
+            continue;
+        }
+        progress->addWork(1, 0);
+        Diff::Source oldContent = kind == FileChange::Added ? Diff::empty() : sourceOf(oldSide);
+        Diff::Source newContent = kind == FileChange::Removed ? Diff::empty() : sourceOf(newSide);
+        compared.push_back(pool.submit([this, path, kind, oldContent, newContent, oldSide, newSide, sameAlgorithm]() {
+            progress->checkCancelled();
+            FileDiff result;
+            // Objects are named by the SHA-256 of their content, whatever the digest algorithm
+            if (kind != FileChange::Modified || sameAlgorithm || newSide.filepath.empty() ||
+                FileHandler::hashFile(newSide.filepath, Digest::Strong) != oldSide.objectId) {
+                result = Diff::compare(path, kind, oldContent, newContent);
+            }
+            progress->advance(1, 0);
+            return result;
+        }));
     }
 
-    zipClose(zf, NULL /* global comment */);
+    std::vector<FileDiff> diffs;
+    std::exception_ptr failure;
+    for (auto& result : compared) {
+        try {
+            FileDiff fileDiff = pool.wait(result);
+            if (fileDiff.kind != FileChange::Modified || fileDiff.binary || !fileDiff.hunks.empty()) {
+                diffs.push_back(std::move(fileDiff));
+            }
+        } catch (...) {
+            if (!failure) failure = std::current_exception(); // Every comparison must be finished before leaving
+        }
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    return diffs;
 }
 
+void Repository::attachTags(std::vector<VersionInfo>& infos) {
+    std::map<int, std::vector<std::string>> byVersion;
+    for (const auto& [name, versionNumber] : tags()) {
+        byVersion[versionNumber].push_back(name);
+    }
+    for (auto& info : infos) {
+        auto found = byVersion.find(info.version);
+        if (found != byVersion.end()) {
+            info.tags = found->second;
+        }
+    }
+}
 
+// Tags are read from disk each time: they are few, and another process may have changed them
+std::map<std::string, int> Repository::tags() {
+    std::map<std::string, int> tagged;
+    std::ifstream tagsFile(tagsFilePath);
+    std::string line, versionText, name;
+    std::getline(tagsFile, line); // Header
+    while (std::getline(tagsFile, line)) {
+        std::stringstream linestream(line);
+        std::getline(linestream, versionText, ',');
+        std::getline(linestream, name); // Name comes last so it may contain commas
+        if (!versionText.empty() && !name.empty()) {
+            tagged[name] = std::stoi(versionText);
+        }
+    }
+    return tagged;
+}
 
-void Repository::addFileToZip(const std::string& filePath, zipFile& zf, const std::string& baseFolderPath) {
-    std::ifstream inFile(filePath, std::ios_base::binary);
-    if (!inFile) {
-        std::cerr << "Could not open " << filePath << " for reading." << std::endl;
-        return;
+void Repository::saveTags(const std::map<std::string, int>& tagged) {
+    std::filesystem::create_directories(baseRepoPath + "/history");
+    try {
+        std::ofstream tagsFile(journal.stage(tagsFilePath));
+        tagsFile << "version,name\n";
+        for (const auto& [name, versionNumber] : tagged) {
+            tagsFile << versionNumber << "," << name << "\n";
+        }
+        tagsFile.close();
+        if (!tagsFile) {
+            throw std::runtime_error("Failed to write tags: " + tagsFilePath);
+        }
+        journal.commit();
+    } catch (...) {
+        journal.abort();
+        throw;
     }
+}
 
-    std::string contents((std::istreambuf_iterator<char>(inFile)),
-                         std::istreambuf_iterator<char>());
-    inFile.close();  // Ensure the file is closed after reading
+void Repository::tag(int versionNumber, const std::string& name) {
+    if (name.empty() || name.find_first_of("\r\n") != std::string::npos) {
+        throw std::runtime_error("Invalid tag name.");
+    }
+    if (!hasVersion(versionNumber)) {
+        throw std::runtime_error("Specified version does not exist.");
+    }
+    std::map<std::string, int> tagged = tags();
+    tagged[name] = versionNumber;
+    saveTags(tagged);
+}
 
-    if (contents.empty()) {
-        std::cerr << "Warning: " << filePath << " is empty or unreadable." << std::endl;
-        return;
+void Repository::untag(const std::string& name) {
+    std::map<std::string, int> tagged = tags();
+    if (tagged.erase(name) == 0) {
+        throw std::runtime_error("No tag named " + name);
     }
+    saveTags(tagged);
+}
 
-    // Calculate the relative path
-    std::filesystem::path fsPath(filePath);
-    std::filesystem::path baseFolderPath_fs(baseFolderPath);
-    std::string relativePath = std::filesystem::relative(fsPath, baseFolderPath_fs).string();
+// Versions are dropped first, and their removal flushed, so no manifest left on disk
+// can refer to an object deleted after. Versions past the version count, left by a
+// rollback, are kept: rollback can still restore them until they are committed over.
+GarbageReport Repository::collectGarbage(const RetentionPolicy& policy, uint64_t budget) {
+    Trace::Span span(Trace::Operation, "gc");
+    progress->checkCancelled();
+    GarbageReport report;
+    std::set<int> tagged;
+    for (const auto& [name, versionNumber] : tags()) {
+        tagged.insert(versionNumber);
+    }
+    bool limited = policy.keepLast >= 0 || policy.keepSinceNs >= 0;
+    std::set<std::string> referenced;
+    for (int versionNumber : committedVersions()) {
+        std::string archive = baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip";
+        VersionInfo info;
+        if (!versionInfo(versionNumber, info)) {
+            continue;
+        }
+        bool keep = !limited || versionNumber >= version - 1 || tagged.count(versionNumber) ||
+                    (policy.keepLast >= 0 && versionNumber >= version - policy.keepLast) ||
+                    (policy.keepSinceNs >= 0 && info.timeNs >= policy.keepSinceNs);
+        if (keep) {
+            for (const auto& entry : loadManifest(versionNumber)) {
+                referenced.insert(entry.objectId);
+            }
+            continue;
+        }
+        for (const std::string& path : {manifestPath(versionNumber), archive}) {
+            std::error_code error;
+            uintmax_t size = std::filesystem::file_size(path, error);
+            if (!error && std::filesystem::remove(path)) {
+                report.bytesReclaimed += size;
+            }
+        }
+        report.versionsRemoved.push_back(versionNumber);
+    }
+    if (!report.versionsRemoved.empty()) {
+        FileHandler::syncDirectory(baseRepoPath + "/history");
+    }
 
-    zip_fileinfo zfi;
-    memset(&zfi, 0, sizeof(zfi));
+    ObjectStore::Collection collection = objects.collect(referenced, budget);
+    report.objectsRemoved = collection.objectsRemoved;
+    report.bytesReclaimed += collection.bytesReclaimed;
+    report.objectsPacked = collection.objectsPacked;
+    report.packsWritten = collection.packsWritten;
+    report.packsRemoved = collection.packsRemoved;
+    report.finished = collection.finished;
+    std::cout << "Collected garbage: removed " << report.versionsRemoved.size() << " versions and "
+              << report.objectsRemoved << " objects, packed " << report.objectsPacked << " objects, reclaimed "
+              << report.bytesReclaimed << " bytes" << std::endl;
+    return report;
+}
 
-    int err = zipOpenNewFileInZip(zf, relativePath.c_str(), &zfi,
-                                  NULL, 0, NULL, 0, NULL,
-                                  Z_DEFLATED, Z_DEFAULT_COMPRESSION);
-    if (err != ZIP_OK) {
-        std::cerr << "Failed to add file to zip: " << relativePath << " with error: " << err << std::endl;
-        return;
+// The manifest is loaded here; file contents are only read when the snapshot is
+Snapshot Repository::snapshot(int versionNumber) {
+    if (!hasVersion(versionNumber)) {
+        throw std::runtime_error("Specified version does not exist.");
     }
+    if (!std::filesystem::exists(manifestPath(versionNumber))) {
+        throw std::runtime_error("Version " + std::to_string(versionNumber) +
+                                 " was committed as a zip archive by an older release and cannot be opened.");
+    }
+    return Snapshot(baseRepoPath, versionNumber, loadManifest(versionNumber), blockCache);
+}
+
+void Repository::setAuthor(const std::string& name) {
+    author = name;
+}
+
 
-    err = zipWriteInFileInZip(zf, contents.data(), contents.size());
-    if (err != ZIP_OK) {
-        std::cerr << "Failed to write file to zip: " << relativePath << std::endl;
-        // Consider removing or not adding the file to the zip if this fails
+// Log how many bytes an operation processed and at what rate
+void Repository::reportThroughput(const std::string& operation, uintmax_t bytes, std::chrono::steady_clock::time_point start) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = bytes / 1e6;
+    std::cout << operation << ", " << megabytes << " MB in " << seconds << " s ("
+              << (seconds > 0 ? megabytes / seconds : 0) << " MB/s)" << std::endl;
+}
+
+
+// Files of a record with their digests as of the last refresh
+std::vector<std::pair<std::string, std::string>> Repository::trackedFiles(const FileRecord& record) {
+    if (currentTree.contains(record.filename)) {
+        return currentTree.files(record.filename);
     }
+    return {{record.filename, record.newHash}};
+}
+
 
-    zipCloseFileInZip(zf);
+std::string Repository::manifestPath(int versionNumber) {
+    return baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".manifest";
 }
 
 
+// Path relative to the repository root, with '/' separators on every platform
+std::string Repository::relativePath(const std::string& path) {
+    namespace fs = std::filesystem;
+    return fs::absolute(path).lexically_normal().lexically_relative(fs::absolute(baseRepoPath).lexically_normal()).generic_string();
+}
+
 
-void Repository::decompressFiles(const std::string& zipPath, const std::string& destDir) {
-    unzFile zipfile = unzOpen(zipPath.c_str());
+// Load the path to object mapping of a commit, empty if the commit has no manifest
+std::vector<ManifestEntry> Repository::loadManifest(int versionNumber) {
+    std::vector<ManifestEntry> manifest;
+    std::ifstream manifestFile(manifestPath(versionNumber));
+    if (!manifestFile.is_open()) {
+        return manifest;
+    }
+
+    std::string line, objectId, digest, path;
+    // Skip the header line
+    std::getline(manifestFile, line);
+    while (std::getline(manifestFile, line)) {
+        std::stringstream linestream(line);
+        std::getline(linestream, objectId, ',');
+        std::getline(linestream, digest, ',');
+        std::getline(linestream, path); // Path comes last so it may contain commas
+        manifest.push_back({path, objectId, digest});
+    }
+    return manifest;
+}
+
+
+// Algorithm of the digests in a manifest, from its header ("object,digest:<id>,path").
+// Empty for manifests that do not name it.
+std::string Repository::manifestDigestId(int versionNumber) {
+    std::ifstream manifestFile(manifestPath(versionNumber));
+    std::string header;
+    std::getline(manifestFile, header);
+    const std::string prefix = "object,digest:";
+    if (header.compare(0, prefix.size(), prefix) != 0) {
+        return "";
+    }
+    return header.substr(prefix.size(), header.find(',', prefix.size()) - prefix.size());
+}
+
+
+void Repository::saveManifest(const std::string& path, const std::vector<ManifestEntry>& manifest) {
+    Trace::Span span(Trace::Metadata, "save manifest");
+    std::ofstream manifestFile(path);
+    if (!manifestFile.is_open()) {
+        throw std::runtime_error("Failed to open manifest file for writing.");
+    }
+    manifestFile << "object,digest:" << Digest::idOf(digestAlgorithm) << ",path\n";
+    for (const auto& entry : manifest) {
+        manifestFile << entry.objectId << "," << entry.digest << "," << entry.path << "\n";
+    }
+    manifestFile.close();
+    if (!manifestFile) {
+        throw std::runtime_error("Failed to write manifest file.");
+    }
+}
+
+
+void Repository::saveVersion(const std::string& path, int versionNumber) {
+    std::ofstream versionFile(path);
+    if (!versionFile.is_open()) {
+        throw std::runtime_error("Failed to open or create version file.");
+    }
+    versionFile << versionNumber;
+    versionFile.close();
+    if (!versionFile) {
+        throw std::runtime_error("Failed to write version file.");
+    }
+}
+
+
+
+// Extract a legacy commit archive entry by entry in fixed-size chunks. Entries outside
+// `selection` are skipped, and so are files whose size and CRC already match.
+void Repository::decompressFiles(const std::string& zipPath, const std::string& destDir,
+                                 const std::vector<std::string>& selection) {
+    unzFile zipfile = unzOpen64(zipPath.c_str());
     if (!zipfile) {
         throw std::runtime_error("Could not open zip file for reading.");
     }
@@ -256,93 +1165,267 @@ void Repository::decompressFiles(const std::string& zipPath, const std::string&
         throw std::runtime_error("Could not read first file in zip archive.");
     }
 
+    std::vector<char> buffer(RESTORE_CHUNK_SIZE);
+    size_t restored = 0, unchanged = 0;
+    uintmax_t restoredBytes = 0;
+    auto start = std::chrono::steady_clock::now();
     do {
         char filename[MAX_FILENAME];
-        unz_file_info fileInfo;
-        if (unzGetCurrentFileInfo(zipfile, &fileInfo, filename, MAX_FILENAME, NULL, 0, NULL, 0) != UNZ_OK) {
+        unz_file_info64 fileInfo;
+        if (unzGetCurrentFileInfo64(zipfile, &fileInfo, filename, MAX_FILENAME, NULL, 0, NULL, 0) != UNZ_OK) {
+            unzClose(zipfile);
             throw std::runtime_error("Could not read file info in zip archive.");
         }
 
-        if (unzOpenCurrentFile(zipfile) != UNZ_OK) {
-            throw std::runtime_error("Could not open file in zip archive.");
-        }
-
         // Construct full path for file/directory
         std::string fullPath = destDir + "/" + filename;
 
         // Check if it's a directory (ends with '/')
         if (filename[strlen(filename) - 1] == '/') {
             std::filesystem::create_directories(fullPath);
-        } else {
-            // Ensure the directory exists before writing file
-            std::filesystem::create_directories(std::filesystem::path(fullPath).parent_path());
-
-            // Create a buffer to hold file contents and read the file
-            char *buffer = new char[fileInfo.uncompressed_size];
-            int bytesRead = unzReadCurrentFile(zipfile, buffer, fileInfo.uncompressed_size);
-
-            if (bytesRead > 0) {
-                std::ofstream outFile(fullPath, std::ios::binary);
-                outFile.write(buffer, bytesRead);
-                outFile.close();
-            }
-
-            delete[] buffer; // Clean up buffer
+            continue;
+        }
+        if (!isSelected(filename, selection)) {
+            continue;
+        }
+        std::error_code error;
+        if (std::filesystem::file_size(fullPath, error) == fileInfo.uncompressed_size && !error &&
+            crcOfFile(fullPath) == fileInfo.crc) {
+            unchanged++;
+            continue;
         }
 
+        if (unzOpenCurrentFile(zipfile) != UNZ_OK) {
+            unzClose(zipfile);
+            throw std::runtime_error("Could not open file in zip archive.");
+        }
+        // Staged; the rollback replaces the working files together once all are extracted
+        std::string stagedPath = journal.stage(fullPath);
+        std::ofstream outFile(stagedPath, std::ios::binary | std::ios::trunc);
+        int bytesRead;
+        while ((bytesRead = unzReadCurrentFile(zipfile, buffer.data(), static_cast<unsigned>(buffer.size()))) > 0) {
+            outFile.write(buffer.data(), bytesRead);
+            restoredBytes += bytesRead;
+        }
         unzCloseCurrentFile(zipfile);
+        outFile.close();
+        if (bytesRead < 0 || !outFile) {
+            unzClose(zipfile);
+            throw std::runtime_error("Could not extract " + std::string(filename) + " from zip archive.");
+        }
+        keepPermissions(fullPath, stagedPath);
+        restored++;
     } while (unzGoToNextFile(zipfile) != UNZ_END_OF_LIST_OF_FILE);
 
     unzClose(zipfile);
+    reportThroughput("Restored " + std::to_string(restored) + " files, " + std::to_string(unchanged) + " unchanged",
+                     restoredBytes, start);
 }
 
 
+// CRC-32 of a file as stored in zip archives, computed in fixed-size chunks
+uint32_t Repository::crcOfFile(const std::string& filepath) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    FileHandler::streamFile(filepath, [&crc](const char* data, size_t size) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(size));
+    });
+    return static_cast<uint32_t>(crc);
+}
 
-void Repository::rollbackToVersion(int versionNumber) {
-    std::string versionedArchiveName = baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip";
 
-    if (!std::filesystem::exists(versionedArchiveName)) {
-        throw std::runtime_error("Specified version does not exist.");
+// Paths given to an operation, relative to the repository: absolute ones are converted,
+// relative ones are already relative to it
+std::vector<std::string> Repository::selectionOf(const std::vector<std::string>& paths) {
+    std::vector<std::string> selection;
+    for (const auto& path : paths) {
+        selection.push_back(std::filesystem::path(path).is_absolute()
+                                ? relativePath(path)
+                                : std::filesystem::path(path).lexically_normal().generic_string());
     }
+    return selection;
+}
 
-    // Clear existing files and directories or implement your strategy here
+// Whether a path relative to the repository root is one of `selection` or lies below one;
+// an empty selection selects everything
+bool Repository::isSelected(const std::string& path, const std::vector<std::string>& selection) {
+    if (selection.empty()) {
+        return true;
+    }
+    for (const auto& selected : selection) {
+        if (path == selected || (path.size() > selected.size() && path.compare(0, selected.size(), selected) == 0 &&
+                                 path[selected.size()] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    decompressFiles(versionedArchiveName, baseRepoPath);
 
-    version = versionNumber;  // Update the version
+// Restore the files of a version, or only `paths` (files or folders, absolute or relative
+// to the repository root) when given. Files whose current content already matches the
+// version are left untouched, so the cost depends on what changed rather than on the
+// size of the repository. Only a full rollback moves the repository to that version.
+// The restored files are staged and replace the working files, with the version number,
+// in one journal transaction: a rollback that fails or is cancelled changes nothing.
+void Repository::rollbackToVersion(int versionNumber, const std::vector<std::string>& paths) {
+    Trace::Span span(Trace::Operation, "rollback");
+    std::string versionedArchiveName = baseRepoPath + "/history/commit_" + std::to_string(versionNumber) + ".zip";
 
-    std::ofstream versionFile(versionFilePath);
-    if (!versionFile.is_open()) {
-        throw std::runtime_error("Failed to open or create version file.");
+    std::vector<std::string> selection = selectionOf(paths);
+    try {
+        if (std::filesystem::exists(manifestPath(versionNumber))) {
+            restoreManifest(versionNumber, selection);
+        } else if (std::filesystem::exists(versionedArchiveName)) {
+            // Commits made before the object store are whole zip archives
+            decompressFiles(versionedArchiveName, baseRepoPath, selection);
+        } else {
+            throw std::runtime_error("Specified version does not exist.");
+        }
+        progress->checkCancelled();
+        if (paths.empty()) {
+            saveVersion(journal.stage(versionFilePath), versionNumber);
+        }
+        journal.commit(&workers());
+    } catch (...) {
+        journal.abort();
+        throw;
+    }
+    if (paths.empty()) {
+        version = versionNumber;  // Update the version
+    }
+}
+
+
+// Restore the selected files of a manifest that differ from the version. Current files are
+// compared by their recorded digest when the manifest uses the repository's algorithm (a stat
+// for files the cache knows), and by their SHA-256 object id otherwise.
+void Repository::restoreManifest(int versionNumber, const std::vector<std::string>& selection) {
+    std::vector<ManifestEntry> entries;
+    for (auto& entry : loadManifest(versionNumber)) {
+        if (isSelected(entry.path, selection)) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    if (entries.empty() && !selection.empty()) {
+        throw std::runtime_error("None of the selected paths are part of the version.");
+    }
+
+    bool sameAlgorithm = manifestDigestId(versionNumber) == Digest::idOf(digestAlgorithm);
+    std::vector<std::future<bool>> unchanged;
+    std::atomic<bool> stopped{false};
+    ThreadPool& pool = workers();
+    for (const auto& entry : entries) {
+        std::string filepath = baseRepoPath + "/" + entry.path;
+        progress->addWork(1, 0);
+        unchanged.push_back(pool.submit([this, filepath, &entry, sameAlgorithm, &stopped]() {
+            progress->checkCancelled();
+            if (stopped || !std::filesystem::is_regular_file(filepath)) {
+                return false;
+            }
+            return sameAlgorithm ? calculateFileHash(filepath, digestAlgorithm) == entry.digest
+                                 : FileHandler::hashFile(filepath, Digest::Strong) == entry.objectId;
+        }));
     }
-    versionFile << version;
-    versionFile.close();
 
+    size_t restored = 0, skipped = 0;
+    uintmax_t restoredBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::exception_ptr failure;
+    for (size_t i = 0; i < entries.size(); i++) {
+        try {
+            if (failure) {
+                unchanged[i].wait(); // Nothing more is restored, but the checks still use `entries`
+                continue;
+            }
+            if (unchanged[i].get()) {
+                skipped++;
+                progress->advance(1, 0);
+                continue;
+            }
+            progress->checkCancelled();
+            std::string filepath = baseRepoPath + "/" + entries[i].path;
+            std::string stagedPath = journal.stage(filepath);
+            objects.restore(entries[i].objectId, stagedPath);
+            keepPermissions(filepath, stagedPath);
+            restored++;
+            uintmax_t size = std::filesystem::file_size(stagedPath);
+            restoredBytes += size;
+            progress->advance(1, size);
+        } catch (...) {
+            failure = std::current_exception();
+            stopped = true; // The remaining checks are skipped
+        }
+    }
+    statCache.save(false);
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    reportThroughput("Restored " + std::to_string(restored) + " files of version " + std::to_string(versionNumber) + ", " +
+                     std::to_string(skipped) + " unchanged", restoredBytes, start);
 }
 
 
 
 // Show the status of files in the repository
 std::vector<bool> Repository::showStatus() {
+    Trace::Span span(Trace::Operation, "status");
     std::vector<bool> modified = std::vector<bool>();
     for (const auto& record : records) {
-        if (record.oldHash != record.newHash) {
+        if (record.oldHash != record.newHash && Trace::verbose()) {
             std::cout << record.filename << " has been modified." << std::endl;
+            for (const auto& filename : modifiedFiles(record.filename)) {
+                std::cout << "    " << filename << std::endl;
+            }
         }
         modified.push_back((record.oldHash != record.newHash));
     }
     return modified;
 }
 
-// Load records from the CSV file into memory
-void Repository::loadRecords() {
+// Rewrite the stored history of every path as delta chains
+void Repository::repack() {
+    Trace::Span span(Trace::Operation, "repack");
+    std::map<std::string, std::vector<std::string>> histories;
+    for (int n : committedVersions()) {
+        for (const auto& entry : loadManifest(n)) {
+            std::vector<std::string>& history = histories[entry.path];
+            if (history.empty() || history.back() != entry.objectId) {
+                history.push_back(entry.objectId);
+            }
+        }
+    }
+    std::vector<std::vector<std::string>> objectHistories;
+    for (auto& [path, history] : histories) {
+        objectHistories.push_back(std::move(history));
+    }
+    objects.repack(objectHistories);
+    blockCache->clear(); // Block layouts changed with the objects
+}
+
+// Files added, removed or modified inside a tracked folder since it was last committed
+std::vector<std::string> Repository::modifiedFiles(const std::string& foldername) {
+    return currentTree.changedFiles(baseTree, foldername);
+}
+
+// Load records into memory, returning whether they came from the CSV file of an older version
+bool Repository::loadRecords() {
+    records.clear();
+    if (recordIndex.open()) {
+        records.reserve(recordIndex.size());
+        for (size_t i = 0; i < recordIndex.size(); i++) {
+            records.push_back(recordIndex.record(i));
+        }
+        recordIndex.close(); // Unmapped so the index can be replaced
+        indexRecords();
+        return false;
+    }
+
     std::ifstream csvFile(csvFilePath);
     if (!csvFile.is_open()) {
         throw std::runtime_error("Failed to open .csv file in repository.");
     }
 
     std::string line, filename, oldHash, newHash;
-    records.clear();
     // Skip the header line
     std::getline(csvFile, line);
     while (std::getline(csvFile, line)) {
@@ -352,34 +1435,43 @@ void Repository::loadRecords() {
         std::getline(linestream, newHash);
         records.push_back({filename, oldHash, newHash});
     }
+    indexRecords();
+    return true;
 }
 
-// Save records from memory to the CSV file
-void Repository::saveRecords() {
-    std::ofstream csvFile(csvFilePath);
-    // std::ofstream csvFile(csvFilePath);
-    if (!csvFile.is_open()) {
-        throw std::runtime_error("Failed to open .csv file for writing.");
-    }
-    // In your initializeRepository and saveRecords functions
-    csvFile << "filename,oldHash,newHash\n";
-     // CSV Header
-    for (const auto& record : records) {
-        csvFile << record.filename << "," << record.oldHash << "," << record.newHash << "\n";
+void Repository::indexRecords() {
+    trackedPaths.clear();
+    for (size_t i = 0; i < records.size(); i++) {
+        trackedPaths.insert(records[i].filename, i);
     }
-    csvFile.close();
+}
+
+// Save records from memory to the index
+void Repository::saveRecords() {
+    Trace::Span span(Trace::Metadata, "save records");
+    recordIndex.write(records);
 }
 
 
 void Repository::untrackFile(const std::string& filename) {
 
-    // Find and remove the record with the given filename
-    auto it = std::find_if(records.begin(), records.end(),
-                           [&filename](const FileRecord& record) { return record.filename == filename; });
-
-    if (it != records.end()) {
-        records.erase(it);
-        saveRecords();  // Save the updated records back to the CSV file
+    // Find and remove the record with the given filename, moving the last record into its place
+    size_t position;
+    if (trackedPaths.find(filename, position)) {
+        std::string trackedName = records[position].filename;
+        trackedPaths.erase(trackedName);
+        if (position + 1 != records.size()) {
+            records[position] = std::move(records.back());
+            trackedPaths.insert(records[position].filename, position);
+        }
+        records.pop_back();
+        saveRecords();  // Save the updated records back to the index
+        if (currentTree.contains(trackedName)) {
+            currentTree.remove(trackedName);
+            baseTree.remove(trackedName);
+            currentTree.save();
+            baseTree.save();
+        }
     } else {
         throw std::runtime_error("The file you selected is not staged.");
     }
@@ -387,7 +1479,9 @@ void Repository::untrackFile(const std::string& filename) {
 
 
 // Helper function to calculate the hash of a file's content
-std::string Repository::calculateFileHash(const std::string& filepath) {
-    std::string content = FileHandler::readFile(filepath);
-    return FileHandler::calculateHash(content);
+std::string Repository::calculateFileHash(const std::string& filepath, Digest::Algorithm algorithm) {
+    if (algorithm == digestAlgorithm) {
+        return statCache.digestOf(filepath);
+    }
+    return FileHandler::hashFile(filepath, algorithm);
 }
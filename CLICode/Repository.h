@@ -2,15 +2,53 @@
 #define REPOSITORY_H
 #define MAX_FILENAME 256
 
+#include <chrono>
+#include <map>
 #include <string>
 #include <vector>
-#include "minizip/zip.h"
+#include "ObjectStore.h"
+#include "Digest.h"
+#include "StatCache.h"
+#include "ThreadPool.h"
+#include "MerkleTree.h"
+#include "RecordIndex.h"
+#include "PathIndex.h"
+#include "Progress.h"
+#include "FileWatcher.h"
+#include "Journal.h"
+#include "CommitLog.h"
+#include "Diff.h"
+#include "Snapshot.h"
 
-// Structure to represent a file record in the repository
-struct FileRecord {
-    std::string filename;
-    std::string oldHash;
-    std::string newHash;
+// A committed version, as listed by the log
+struct VersionInfo {
+    int version = 0;
+    size_t files = 0;   // 0 for versions committed as zip archives by older releases
+    int64_t timeNs = 0; // Commit time, nanoseconds since the epoch
+    // From the commit log; versions committed before it only know their changes
+    int parent = -1;
+    std::string author;
+    uint64_t bytesChanged = 0;
+    std::vector<FileChange> changes;
+    std::vector<std::string> tags;
+};
+
+// Versions kept by collectGarbage besides the latest and the tagged ones: the last
+// `keepLast`, and those committed at or after `keepSinceNs`. With neither set, all are kept.
+struct RetentionPolicy {
+    int keepLast = -1;
+    int64_t keepSinceNs = -1; // Nanoseconds since the epoch
+};
+
+// What a round of collectGarbage did
+struct GarbageReport {
+    std::vector<int> versionsRemoved;
+    size_t objectsRemoved = 0;
+    uint64_t bytesReclaimed = 0;
+    size_t objectsPacked = 0;
+    size_t packsWritten = 0;
+    size_t packsRemoved = 0;
+    bool finished = true; // False when another round has work left
 };
 
 class Repository {
@@ -21,26 +59,103 @@ public:
     bool update();
     void trackFile(const std::string& filename);
     void trackFolder(const std::string& foldername);
+    void trackMany(const std::vector<std::string>& paths);
     void untrackFile(const std::string& filename);
     void updateCommit();
     std::vector<bool> showStatus();
-    void rollbackToVersion(int versionNumber);
+    std::vector<std::string> modifiedFiles(const std::string& foldername);
+    void rollbackToVersion(int versionNumber, const std::vector<std::string>& paths = {});
+    void repack();
+    void exportVersion(int versionNumber, const std::string& zipPath);
+    std::vector<VersionInfo> versions();
+    // Versions that changed `path`, a file or folder, oldest first
+    std::vector<VersionInfo> history(const std::string& path);
+    void setAuthor(const std::string& name); // Recorded with later commits
+    static const int WORKING_FILES = -1; // The tracked files as they are now, for diff
+    // Changes from `fromVersion` to `toVersion`, restricted to `paths` (files or folders) when given
+    std::vector<FileDiff> diff(int fromVersion, int toVersion = WORKING_FILES, const std::vector<std::string>& paths = {});
+    // Read-only view of a committed version, read from history without touching the working files
+    Snapshot snapshot(int versionNumber);
+    // Name a version, replacing any tag of the same name; collectGarbage keeps tagged versions
+    void tag(int versionNumber, const std::string& name);
+    void untag(const std::string& name);
+    std::map<std::string, int> tags();
+    static const uint64_t GC_ROUND_BYTES = 64 * 1024 * 1024;
+    // One round of garbage collection: drops the versions `policy` does not keep, deletes
+    // the objects no kept version needs and packs small ones, copying about `budget` bytes
+    // at most so other operations do not wait long. Call again until the report is finished.
+    GarbageReport collectGarbage(const RetentionPolicy& policy, uint64_t budget = GC_ROUND_BYTES);
+    // Compression of files ending in `extension`, or of all others with "*"; applies to later commits
+    void setCompression(const std::string& extension, const std::string& codec, int level);
     std::vector<std::string> getFiles();
     int getVersion();
+    Digest::Algorithm getDigestAlgorithm();
+    void setDigestAlgorithm(Digest::Algorithm algorithm);
+    static bool isReservedName(const std::string& name); // Metadata entries at the repository root
+    static bool isRepository(const std::string& repoPath);
+    static std::vector<std::string> metadataPaths(const std::string& repoPath); // Files loaded by the constructor
+    void setWorkerCount(unsigned count);
+    // Report the work of later operations to `progress`, which can also cancel them; nullptr to stop
+    void setProgress(Progress* progress);
+    // Follow changes under the repository as they happen, so refreshing only hashes what
+    // changed. `listener` is called from the watcher's thread when something changes.
+    void watch(FileWatcher::Listener listener = nullptr);
 private:
     std::string baseRepoPath; // Base path of the repository
-    std::string csvFilePath; // Path to the CSV file within the repository
+    std::string csvFilePath; // Records of repositories created before the binary index
+    RecordIndex recordIndex; // Binary store of the records, version_control.idx
     std::vector<FileRecord> records; // In-memory storage of file records
+    PathIndex trackedPaths; // Position of each record in `records` by path
     int version = 0;
     std::string versionFilePath;
-    void decompressFiles(const std::string& zipPath, const std::string& destDir);
-    void compressFiles(const std::vector<std::string>& files, const std::string& outputPath);
-    void loadRecords(); // Load records from the CSV file
-    void saveRecords(); // Save records to the CSV file
-    std::string calculateFileHash(const std::string& filepath); // Calculate hash of a file
-    std::string calculateFolderHash(const std::string& foldername);
-    void addFileToZip(const std::string& filePath, zipFile& zf, const std::string& baseFolderPath);
-
+    std::string digestFilePath; // Id of the algorithm the record hashes were computed with
+    std::string compressionFilePath; // Compression rules by extension, history/compression.csv
+    std::string tagsFilePath; // Tag names and their versions, history/tags.csv
+    Digest::Algorithm digestAlgorithm = Digest::Fast;
+    ObjectStore objects; // Content-addressed storage of committed file contents
+    StatCache statCache; // Digests of tracked files, reused while their stat data is unchanged
+    MerkleTree currentTree; // Tracked folders as of the last refresh
+    MerkleTree baseTree;    // Tracked folders as of the last commit
+    Journal journal; // Makes commits and rollbacks all-or-nothing
+    CommitLog commitLog; // Parent, author, time and changes of each commit, history/commits.log
+    std::string commitBlockPath; // Log block of the last commit until it is appended, history/commit.block
+    std::shared_ptr<BlockCache> blockCache = std::make_shared<BlockCache>(); // Shared by the snapshots
+    std::string author;
+    unsigned workerCount = ThreadPool::defaultWorkerCount();
+    Progress idle; // Receives the work of operations nobody follows
+    std::unique_ptr<FileWatcher> watcher; // Set by watch()
+    Progress* progress = &idle;
+    std::unique_ptr<ThreadPool> pool; // Created on first use; declared last so it stops before the members its tasks use
+    ThreadPool& workers();
+    void decompressFiles(const std::string& zipPath, const std::string& destDir, const std::vector<std::string>& selection);
+    void restoreManifest(int versionNumber, const std::vector<std::string>& selection);
+    std::vector<std::string> selectionOf(const std::vector<std::string>& paths);
+    static bool isSelected(const std::string& path, const std::vector<std::string>& selection);
+    static uint32_t crcOfFile(const std::string& filepath);
+    std::vector<std::pair<std::string, std::string>> trackedFiles(const FileRecord& record);
+    void reportThroughput(const std::string& operation, uintmax_t bytes, std::chrono::steady_clock::time_point start);
+    std::string manifestPath(int versionNumber);
+    std::vector<ManifestEntry> loadManifest(int versionNumber);
+    bool versionInfo(int versionNumber, VersionInfo& info); // False if the version is lost
+    bool hasVersion(int versionNumber); // Its manifest or archive is in history
+    std::vector<int> committedVersions(); // With a manifest or archive in history, in order
+    void attachTags(std::vector<VersionInfo>& infos);
+    void saveTags(const std::map<std::string, int>& tagged);
+    void saveManifest(const std::string& path, const std::vector<ManifestEntry>& manifest);
+    static void saveVersion(const std::string& path, int versionNumber);
+    std::string manifestDigestId(int versionNumber);
+    std::string relativePath(const std::string& path);
+    bool loadRecords(); // Load records from the index, or from the CSV file of an older repository
+    void saveRecords(); // Save records to the index
+    void indexRecords(); // Rebuild trackedPaths from records
+    void saveDigestAlgorithm();
+    void migrateDigests(Digest::Algorithm from, bool concatenatedFolders);
+    std::vector<std::string> calculateRecordHashes(const std::vector<std::string>& paths, Digest::Algorithm algorithm,
+                                                   bool concatenatedFolders);
+    void updateChanged(const std::vector<std::string>& changedPaths);
+    std::string updateFolderHash(const std::string& foldername, const std::vector<std::string>& changedPaths);
+    std::string calculateFileHash(const std::string& filepath, Digest::Algorithm algorithm); // Calculate hash of a file
+    std::string calculateFolderHash(const std::string& foldername, Digest::Algorithm algorithm);
 };
 
 #endif // REPOSITORY_H
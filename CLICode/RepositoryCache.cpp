@@ -0,0 +1,126 @@
+#include "RepositoryCache.h"
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+struct RepositoryCache::Session::Entry {
+    std::mutex mutex; // Held by the session using the repository
+    std::string repoPath;
+    std::unique_ptr<VersionControlSystem> system; // Loaded on first use
+    Stamp stamp; // Metadata as the system last left it
+};
+
+namespace {
+
+bool sameStat(const FileStat& a, const FileStat& b) {
+    return a.size == b.size && a.mtimeNs == b.mtimeNs && a.ctimeNs == b.ctimeNs && a.inode == b.inode;
+}
+
+}
+
+// Paths are compared in canonical form, so "repo" and "./repo/" share an entry
+std::string RepositoryCache::keyOf(const std::string& repoPath) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(repoPath, error);
+    return error ? repoPath : canonical.string();
+}
+
+RepositoryCache::Stamp RepositoryCache::stampOf(const std::string& repoPath) {
+    Stamp stamp;
+    for (const std::string& path : Repository::metadataPaths(repoPath)) {
+        FileStat stat;
+        if (!FileHandler::statFile(path, stat)) {
+            stat = FileStat();
+        }
+        stamp.push_back(stat);
+    }
+    return stamp;
+}
+
+// Reuse the loaded repository unless its metadata changed behind its back
+RepositoryCache::Session RepositoryCache::open(const std::string& repoPath) {
+    std::string key = keyOf(repoPath);
+    std::shared_ptr<Session::Entry> entry;
+    FileWatcher::Listener listener;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<Session::Entry>& slot = entries[key];
+        if (!slot) {
+            slot = std::make_shared<Session::Entry>();
+            slot->repoPath = repoPath;
+        }
+        entry = slot;
+        auto watched = listeners.find(key);
+        if (watched != listeners.end()) {
+            listener = watched->second;
+        }
+    }
+
+    Session session(*this, key, entry);
+    Stamp stamp = stampOf(entry->repoPath);
+    bool current = entry->system && stamp.size() == entry->stamp.size() &&
+                   std::equal(stamp.begin(), stamp.end(), entry->stamp.begin(), sameStat);
+    if (!current) {
+        entry->system = std::make_unique<VersionControlSystem>(entry->repoPath);
+    }
+    if (listener) {
+        entry->system->watch(listener); // Does nothing if the system is watching already
+    }
+    return session;
+}
+
+void RepositoryCache::forget(const std::string& repoPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(keyOf(repoPath));
+}
+
+void RepositoryCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
+
+void RepositoryCache::watch(const std::string& repoPath, FileWatcher::Listener listener) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listeners[keyOf(repoPath)] = std::move(listener);
+}
+
+// Remove an entry unless it was replaced meanwhile
+void RepositoryCache::drop(const std::string& key, const std::shared_ptr<Session::Entry>& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second == entry) {
+        entries.erase(it);
+    }
+}
+
+// Constructor, waits for the repository to be free
+RepositoryCache::Session::Session(RepositoryCache& cache, std::string key, std::shared_ptr<Entry> entry)
+    : cache(&cache), key(std::move(key)), entry(std::move(entry)), lock(this->entry->mutex),
+      exceptions(std::uncaught_exceptions()) {
+}
+
+RepositoryCache::Session::Session(Session&& other) noexcept
+    : cache(other.cache), key(std::move(other.key)), entry(std::move(other.entry)), lock(std::move(other.lock)),
+      exceptions(other.exceptions) {
+}
+
+RepositoryCache::Session::~Session() {
+    if (!entry) {
+        return; // Moved from
+    }
+    if (std::uncaught_exceptions() > exceptions || !entry->system) {
+        entry->system.reset();
+        lock.unlock();
+        cache->drop(key, entry);
+        return;
+    }
+    entry->stamp = stampOf(entry->repoPath);
+}
+
+VersionControlSystem& RepositoryCache::Session::operator*() {
+    return *entry->system;
+}
+
+VersionControlSystem* RepositoryCache::Session::operator->() {
+    return entry->system.get();
+}
@@ -0,0 +1,55 @@
+#ifndef REPOSITORY_CACHE_H
+#define REPOSITORY_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FileHandler.h"
+#include "VersionControlSystem.h"
+
+// Loaded repositories by path, so the records, digests and version are read once
+// rather than on every action. An entry is reloaded when the repository's metadata
+// files (Repository::metadataPaths) changed on disk since it was last used, which
+// is how changes made by another process or window are picked up.
+class RepositoryCache {
+public:
+    // Exclusive use of a cached repository. When the session ends, the metadata as it
+    // is then on disk is taken as the entry's own; if it ends by an exception, the
+    // entry is dropped, since its memory may no longer match the disk.
+    class Session {
+    public:
+        Session(Session&& other) noexcept;
+        ~Session();
+        VersionControlSystem& operator*();
+        VersionControlSystem* operator->();
+    private:
+        friend class RepositoryCache;
+        struct Entry;
+        Session(RepositoryCache& cache, std::string key, std::shared_ptr<Entry> entry);
+        RepositoryCache* cache;
+        std::string key;
+        std::shared_ptr<Entry> entry;
+        std::unique_lock<std::mutex> lock;
+        int exceptions; // Uncaught when the session started
+    };
+
+    Session open(const std::string& repoPath); // Waits while another session uses the repository
+    void forget(const std::string& repoPath);  // After the repository was created or removed
+    void clear();
+    // Watch the repository's files with `listener` from its next session on. The listener
+    // outlives the loaded repository, so it is registered again whenever that is reloaded.
+    void watch(const std::string& repoPath, FileWatcher::Listener listener);
+private:
+    using Stamp = std::vector<FileStat>; // One per metadata file, zeroed when missing
+
+    std::mutex mutex; // Guards entries and listeners, not the repositories
+    std::map<std::string, std::shared_ptr<Session::Entry>> entries;
+    std::map<std::string, FileWatcher::Listener> listeners; // By key, kept when entries are dropped
+    static std::string keyOf(const std::string& repoPath);
+    static Stamp stampOf(const std::string& repoPath);
+    void drop(const std::string& key, const std::shared_ptr<Session::Entry>& entry);
+};
+
+#endif // REPOSITORY_CACHE_H
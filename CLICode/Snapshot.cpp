@@ -0,0 +1,205 @@
+#include "Snapshot.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+// Key of an object rebuilt whole, which repack may later store in blocks
+const size_t WHOLE_OBJECT = SIZE_MAX;
+
+}
+
+// Constructor
+BlockCache::BlockCache(size_t capacity)
+    : capacity(capacity) {
+}
+
+size_t BlockCache::KeyHash::operator()(const Key& key) const {
+    return std::hash<std::string>()(key.first) ^ (key.second * 0x9e3779b97f4a7c15ULL);
+}
+
+// Blocks are decompressed outside the lock, so readers of different blocks do not wait
+// for each other; two readers of the same missing block may both decompress it
+std::shared_ptr<const std::string> BlockCache::block(const std::string& objectId, size_t index,
+                                                     const std::function<std::string()>& load) {
+    Key key(objectId, index);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = positions.find(key);
+        if (found != positions.end()) {
+            entries.splice(entries.begin(), entries, found->second);
+            Trace::count(Trace::BlockCacheHits);
+            return found->second->data;
+        }
+    }
+    Trace::count(Trace::BlockCacheMisses);
+    auto data = std::make_shared<const std::string>(load());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (positions.count(key) == 0) {
+        entries.push_front({key, data});
+        positions[key] = entries.begin();
+        bytes += data->size();
+        // The block just read stays even if it alone exceeds the capacity
+        while (bytes > capacity && entries.size() > 1) {
+            bytes -= entries.back().data->size();
+            positions.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+    return data;
+}
+
+ObjectStore::Layout BlockCache::layout(ObjectStore& objects, const std::string& objectId) {
+    ObjectStore::Location location = objects.locate(objectId);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = layouts.find(objectId);
+        if (found != layouts.end() && found->second.location == location) {
+            return found->second;
+        }
+    }
+    ObjectStore::Layout layout = objects.layout(objectId);
+    std::lock_guard<std::mutex> lock(mutex);
+    layouts[objectId] = layout;
+    return layout;
+}
+
+void BlockCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    positions.clear();
+    layouts.clear();
+    bytes = 0;
+}
+
+// Constructor
+Snapshot::Snapshot(const std::string& repoPath, int version, std::vector<ManifestEntry> manifest,
+                   std::shared_ptr<BlockCache> cache)
+    : repoPath(repoPath), versionNumber(version), manifest(std::move(manifest)),
+      objects(std::make_shared<ObjectStore>(repoPath + "/history/objects")), cache(std::move(cache)) {
+    std::sort(this->manifest.begin(), this->manifest.end(),
+              [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+}
+
+int Snapshot::version() const {
+    return versionNumber;
+}
+
+const std::vector<ManifestEntry>& Snapshot::files() const {
+    return manifest;
+}
+
+// Path relative to the repository root, with '/' separators, as in manifests
+std::string Snapshot::keyOf(const std::string& path) const {
+    namespace fs = std::filesystem;
+    fs::path key = fs::path(path).is_absolute()
+                       ? fs::path(path).lexically_normal().lexically_relative(fs::path(repoPath).lexically_normal())
+                       : fs::path(path).lexically_normal();
+    std::string text = key.generic_string();
+    while (!text.empty() && text.back() == '/') {
+        text.pop_back();
+    }
+    return text == "." ? "" : text;
+}
+
+const ManifestEntry& Snapshot::entryOf(const std::string& path) const {
+    std::string key = keyOf(path);
+    auto found = std::lower_bound(manifest.begin(), manifest.end(), key,
+                                  [](const ManifestEntry& entry, const std::string& key) { return entry.path < key; });
+    if (found == manifest.end() || found->path != key) {
+        throw std::runtime_error("Version " + std::to_string(versionNumber) + " has no file " + key);
+    }
+    return *found;
+}
+
+bool Snapshot::contains(const std::string& path) const {
+    std::string key = keyOf(path);
+    return std::binary_search(manifest.begin(), manifest.end(), ManifestEntry{key, "", ""},
+                              [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+}
+
+std::vector<std::string> Snapshot::list(const std::string& folder) const {
+    std::string prefix = keyOf(folder);
+    if (!prefix.empty()) {
+        prefix += "/";
+    }
+    std::vector<std::string> paths;
+    auto it = std::lower_bound(manifest.begin(), manifest.end(), prefix,
+                               [](const ManifestEntry& entry, const std::string& key) { return entry.path < key; });
+    for (; it != manifest.end() && it->path.compare(0, prefix.size(), prefix) == 0; ++it) {
+        paths.push_back(it->path);
+    }
+    return paths;
+}
+
+// Objects that are not stored in blocks are rebuilt whole once and cached as one block
+std::shared_ptr<const std::string> Snapshot::whole(const std::string& objectId) {
+    ObjectStore& store = *objects;
+    return cache->block(objectId, WHOLE_OBJECT, [&store, objectId]() {
+        std::string content;
+        store.read(objectId, [&content](const char* data, size_t size) { content.append(data, size); });
+        return content;
+    });
+}
+
+uint64_t Snapshot::size(const std::string& path) {
+    const ManifestEntry& entry = entryOf(path);
+    ObjectStore::Layout layout = cache->layout(*objects, entry.objectId);
+    if (layout.blocked) {
+        return layout.size;
+    }
+    return whole(entry.objectId)->size();
+}
+
+// Only the blocks covering the range are read from the object file and decompressed
+size_t Snapshot::read(const std::string& path, uint64_t offset, char* buffer, size_t length) {
+    Trace::Span span(Trace::Read, "read snapshot", path);
+    const ManifestEntry& entry = entryOf(path);
+    ObjectStore& store = *objects;
+    std::string objectId = entry.objectId;
+    ObjectStore::Layout layout = cache->layout(store, objectId);
+    if (!layout.blocked) {
+        std::shared_ptr<const std::string> content = whole(objectId);
+        if (offset >= content->size()) {
+            return 0;
+        }
+        size_t count = static_cast<size_t>(std::min<uint64_t>(length, content->size() - offset));
+        std::memcpy(buffer, content->data() + offset, count);
+        return count;
+    }
+
+    auto first = std::upper_bound(layout.blocks.begin(), layout.blocks.end(), offset,
+                                  [](uint64_t offset, const ObjectStore::Block& block) { return offset < block.offset; });
+    if (first == layout.blocks.begin()) {
+        return 0;
+    }
+    size_t copied = 0;
+    for (auto it = first - 1; it != layout.blocks.end() && copied < length; ++it) {
+        const ObjectStore::Block& block = *it;
+        uint64_t position = offset + copied;
+        if (position >= block.offset + block.rawSize) {
+            continue; // Past the end of the content
+        }
+        size_t index = it - layout.blocks.begin();
+        std::shared_ptr<const std::string> data = cache->block(objectId, index, [&store, objectId, &layout, index]() {
+            return store.readBlock(objectId, layout, index);
+        });
+        size_t start = static_cast<size_t>(position - block.offset);
+        size_t count = std::min(length - copied, data->size() - start);
+        std::memcpy(buffer + copied, data->data() + start, count);
+        copied += count;
+    }
+    return copied;
+}
+
+void Snapshot::stream(const std::string& path, const std::function<void(const char*, size_t)>& sink) {
+    objects->read(entryOf(path).objectId, sink);
+}
+
+void Snapshot::extract(const std::string& path, const std::string& destPath) {
+    objects->restore(entryOf(path).objectId, destPath);
+}
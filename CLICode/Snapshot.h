@@ -0,0 +1,83 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ObjectStore.h"
+
+// A single file captured by a commit, as listed in history/commit_N.manifest
+struct ManifestEntry {
+    std::string path;     // Path relative to the repository root
+    std::string objectId; // Object holding the file's content
+    std::string digest;   // Hash of the file's content with the repository's digest algorithm
+};
+
+// Decompressed blocks of objects, the least recently used dropped first once they hold
+// more than `capacity` bytes, and the block layouts of the objects read. Objects are
+// named by their content, so an entry stays valid whatever version it is read from;
+// a layout is read again once its object moved (repacked or collected into a pack).
+class BlockCache {
+public:
+    static const size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+    explicit BlockCache(size_t capacity = DEFAULT_CAPACITY);
+    // Block `index` of an object, decompressed by `load` unless cached
+    std::shared_ptr<const std::string> block(const std::string& objectId, size_t index,
+                                             const std::function<std::string()>& load);
+    ObjectStore::Layout layout(ObjectStore& objects, const std::string& objectId);
+    void clear();
+private:
+    using Key = std::pair<std::string, size_t>;
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct Entry {
+        Key key;
+        std::shared_ptr<const std::string> data;
+    };
+
+    std::mutex mutex;
+    size_t capacity;
+    size_t bytes = 0;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> positions;
+    std::map<std::string, ObjectStore::Layout> layouts;
+};
+
+// Read-only view of a committed version. Files are read straight from the object store,
+// in chunks or at any offset, without touching the working files; the blocks read are
+// kept in the repository's BlockCache, so reading around in a file is cheap. A snapshot
+// holds its own handle on the store and can outlive the Repository it came from.
+class Snapshot {
+public:
+    Snapshot(const std::string& repoPath, int version, std::vector<ManifestEntry> manifest,
+             std::shared_ptr<BlockCache> cache);
+    int version() const;
+    // Paths are relative to the repository, or absolute below it
+    const std::vector<ManifestEntry>& files() const; // Sorted by path
+    bool contains(const std::string& path) const;
+    std::vector<std::string> list(const std::string& folder = "") const; // Files in and below `folder`
+    uint64_t size(const std::string& path);
+    // Copies up to `length` bytes from `offset` into `buffer`; returns how many, 0 past the end
+    size_t read(const std::string& path, uint64_t offset, char* buffer, size_t length);
+    // Passes the whole content to `sink` in chunks, bypassing the cache
+    void stream(const std::string& path, const std::function<void(const char*, size_t)>& sink);
+    void extract(const std::string& path, const std::string& destPath);
+private:
+    std::string repoPath;
+    int versionNumber;
+    std::vector<ManifestEntry> manifest;
+    std::shared_ptr<ObjectStore> objects;
+    std::shared_ptr<BlockCache> cache;
+    std::string keyOf(const std::string& path) const;
+    const ManifestEntry& entryOf(const std::string& path) const;
+    std::shared_ptr<const std::string> whole(const std::string& objectId);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,146 @@
+#include "StatCache.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// A file modified this close to the moment its digest was taken may still have
+// the same timestamp after a later change (racy-git problem). 2 seconds covers
+// the coarsest timestamps we meet, FAT's.
+const int64_t RACY_WINDOW_NS = 2000000000LL;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool sameStat(const FileStat& a, const FileStat& b) {
+    return a.size == b.size && a.mtimeNs == b.mtimeNs && a.ctimeNs == b.ctimeNs && a.inode == b.inode;
+}
+
+}
+
+// Constructor
+StatCache::StatCache(const std::string& cachePath)
+    : cachePath(cachePath) {
+}
+
+// Load the cache written for `algorithm`; a cache of another algorithm is discarded
+void StatCache::load(Digest::Algorithm algorithm) {
+    this->algorithm = algorithm;
+    entries.clear();
+    dirty = false;
+
+    std::ifstream cacheFile(cachePath);
+    if (!cacheFile.is_open()) {
+        return;
+    }
+
+    std::string line;
+    std::getline(cacheFile, line);
+    if (line != "stat_cache," + Digest::idOf(algorithm)) {
+        dirty = true;
+        return;
+    }
+
+    // Rows are size,mtime,ctime,inode,verified,digest,path; the path comes last so it may contain commas
+    while (std::getline(cacheFile, line)) {
+        Entry entry;
+        const char* p = line.c_str();
+        char* end = nullptr;
+        entry.stat.size = std::strtoull(p, &end, 10);
+        entry.stat.mtimeNs = std::strtoll(end + 1, &end, 10);
+        entry.stat.ctimeNs = std::strtoll(end + 1, &end, 10);
+        entry.stat.inode = std::strtoull(end + 1, &end, 10);
+        entry.verifiedAtNs = std::strtoll(end + 1, &end, 10);
+        size_t digestStart = static_cast<size_t>(end + 1 - p);
+        size_t digestEnd = line.find(',', digestStart);
+        if (*end != ',' || digestEnd == std::string::npos) {
+            continue; // Damaged row, the file will simply be hashed again
+        }
+        entry.digest = line.substr(digestStart, digestEnd - digestStart);
+        entries[line.substr(digestEnd + 1)] = entry;
+    }
+}
+
+// Write the cache if anything changed, through a temporary file so a crash never leaves half a cache
+void StatCache::save(bool pruneUnused) {
+    Trace::Span span(Trace::Metadata, "save stat cache");
+    if (pruneUnused) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!it->second.used) {
+                it = entries.erase(it);
+                dirty = true;
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (!dirty) {
+        return;
+    }
+
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path());
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream cacheFile(tempPath);
+    if (!cacheFile.is_open()) {
+        throw std::runtime_error("Failed to open stat cache for writing.");
+    }
+    cacheFile << "stat_cache," << Digest::idOf(algorithm) << "\n";
+    for (const auto& [path, entry] : entries) {
+        cacheFile << entry.stat.size << "," << entry.stat.mtimeNs << "," << entry.stat.ctimeNs << ","
+                  << entry.stat.inode << "," << entry.verifiedAtNs << "," << entry.digest << "," << path << "\n";
+    }
+    cacheFile.close();
+    if (!cacheFile) {
+        throw std::runtime_error("Failed to write stat cache.");
+    }
+    std::filesystem::rename(tempPath, cachePath);
+    dirty = false;
+}
+
+// Forget every cached digest, e.g. after the digest algorithm changed
+void StatCache::reset(Digest::Algorithm algorithm) {
+    this->algorithm = algorithm;
+    entries.clear();
+    dirty = true;
+}
+
+// Digest of a file, re-hashing it only if its stat data changed since it was cached
+// or if it was modified too close to the moment it was hashed to tell
+std::string StatCache::digestOf(const std::string& filepath) {
+    FileStat stat;
+    if (!FileHandler::statFile(filepath, stat)) {
+        throw std::runtime_error("Could not open file: " + filepath);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(filepath);
+        if (it != entries.end()) {
+            Entry& entry = it->second;
+            entry.used = true;
+            if (sameStat(entry.stat, stat) && stat.mtimeNs + RACY_WINDOW_NS <= entry.verifiedAtNs) {
+                Trace::count(Trace::StatCacheHits);
+                return entry.digest;
+            }
+        }
+    }
+
+    // Hash without holding the lock so other files are hashed meanwhile
+    Trace::count(Trace::StatCacheMisses);
+    Entry entry;
+    entry.stat = stat;
+    entry.verifiedAtNs = nowNs();
+    entry.digest = FileHandler::hashFile(filepath, algorithm);
+    entry.used = true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[filepath] = entry;
+    dirty = true;
+    return entry.digest;
+}
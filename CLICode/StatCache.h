@@ -0,0 +1,36 @@
+#ifndef STAT_CACHE_H
+#define STAT_CACHE_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Digest.h"
+#include "FileHandler.h"
+
+// Persistent cache of file digests keyed by path, in the spirit of git's index.
+// A cached digest is reused as long as the file's size, timestamps and inode
+// are unchanged, so refreshing an unchanged tree costs one stat per file.
+class StatCache {
+public:
+    StatCache(const std::string& cachePath);
+    void load(Digest::Algorithm algorithm);
+    void save(bool pruneUnused); // Unused entries belong to files no longer tracked
+    void reset(Digest::Algorithm algorithm);
+    std::string digestOf(const std::string& filepath); // Safe to call from several threads at once
+private:
+    // Stat data of a file at the time its digest was computed
+    struct Entry {
+        FileStat stat;
+        std::string digest;
+        int64_t verifiedAtNs = 0; // When the digest was computed
+        bool used = false;
+    };
+
+    std::string cachePath;
+    Digest::Algorithm algorithm = Digest::Fast;
+    std::unordered_map<std::string, Entry> entries;
+    bool dirty = false;
+    std::mutex mutex; // Guards entries and dirty while digests are computed in parallel
+};
+
+#endif // STAT_CACHE_H
@@ -0,0 +1,118 @@
+#include "ThreadPool.h"
+#include <cstdlib>
+
+namespace {
+
+// Pool and queue index of the worker running on the current thread, if any
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local unsigned currentIndex = 0;
+
+}
+
+// Constructor
+ThreadPool::ThreadPool(unsigned workerCount) {
+    if (workerCount == 0) {
+        workerCount = 1;
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+// Runs every task still queued, then stops the workers
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Queues are all created before the first worker starts, unlike the workers themselves
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(queues.size());
+}
+
+unsigned ThreadPool::defaultWorkerCount() {
+    if (const char* configured = std::getenv("ZIM_VCS_THREADS")) {
+        int count = std::atoi(configured);
+        if (count > 0) {
+            return static_cast<unsigned>(count);
+        }
+    }
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void ThreadPool::push(std::function<void()> task) {
+    unsigned index = currentPool == this ? currentIndex : nextQueue++ % size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counting under sleepMutex so a worker cannot miss the wake-up between its check and its wait
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending++;
+    }
+    wake.notify_one();
+}
+
+// Newest task of the worker's own queue, or the oldest task of another queue
+bool ThreadPool::tryPop(unsigned index, std::function<void()>& task) {
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending--;
+            return true;
+        }
+    }
+    for (unsigned offset = 1; offset < size(); offset++) {
+        Queue& victim = *queues[(index + offset) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run one queued task on the calling thread, if there is any
+bool ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    if (!tryPop(currentPool == this ? currentIndex : 0, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::run(unsigned index) {
+    currentPool = this;
+    currentIndex = index;
+    std::function<void()> task;
+    while (true) {
+        if (tryPop(index, task)) {
+            task(); // Exceptions are captured by the packaged_task
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
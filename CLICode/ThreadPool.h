@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. A worker takes the
+// newest task of its own deque and, when that is empty, steals the oldest task
+// of another worker, so uneven work (one huge file among small ones) spreads
+// across all cores. Tasks submitted from a worker go to that worker's deque.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned workerCount);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const;
+    // ZIM_VCS_THREADS if set, the number of hardware threads otherwise
+    static unsigned defaultWorkerCount();
+
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        push([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    // Wait for a task's result, running queued tasks meanwhile. Tasks that wait for
+    // other tasks must use this rather than get(), or every worker could end up waiting.
+    template <typename T>
+    T wait(std::future<T>& result) {
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) {
+                result.wait_for(std::chrono::milliseconds(1)); // Everything left is already running
+            }
+        }
+        return result.get();
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0}; // Tasks sitting in a queue
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+
+    void push(std::function<void()> task);
+    bool runPendingTask();
+    bool tryPop(unsigned index, std::function<void()>& task);
+    void run(unsigned index);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,234 @@
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const unsigned METRICS = 1;
+const unsigned TRACING = 2;
+
+const char* PHASE_NAMES[Trace::PhaseCount] = {"operation", "file", "walk", "stat", "read", "hash", "compress", "write",
+                                              "metadata", "compare"};
+const char* COUNTER_NAMES[Trace::CounterCount] = {"files_hashed", "bytes_hashed", "stat_cache_hits",
+                                                  "stat_cache_misses", "files_stored", "bytes_stored",
+                                                  "bytes_written", "objects_reused", "files_restored",
+                                                  "bytes_restored", "block_cache_hits",
+                                                  "block_cache_misses"};
+
+std::atomic<unsigned> modes{0};
+std::atomic<bool> verboseLogging{true};
+std::atomic<uint64_t> phaseNs[Trace::PhaseCount];
+std::atomic<uint64_t> phaseSpans[Trace::PhaseCount];
+std::atomic<uint64_t> counters[Trace::CounterCount];
+
+struct Event {
+    const char* name;
+    Trace::Phase phase;
+    int64_t startNs;
+    int64_t durationNs;
+    std::string detail;
+};
+
+// Events of one thread. Only its thread appends to it, so the lock is uncontended
+// until the trace is written.
+struct ThreadEvents {
+    std::mutex mutex;
+    std::vector<Event> events;
+    unsigned threadId = 0;
+    unsigned generation = 0;
+};
+
+std::mutex traceMutex; // Guards the fields below
+std::vector<std::shared_ptr<ThreadEvents>> threadEvents;
+std::string tracePath;
+int64_t traceStartNs = 0;
+std::atomic<unsigned> traceGeneration{0}; // Tells threads their events belong to an older trace
+thread_local std::shared_ptr<ThreadEvents> localEvents;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ThreadEvents& eventsOfThread() {
+    unsigned generation = traceGeneration.load(std::memory_order_acquire);
+    if (!localEvents || localEvents->generation != generation) {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        localEvents = std::make_shared<ThreadEvents>();
+        localEvents->threadId = static_cast<unsigned>(threadEvents.size() + 1);
+        localEvents->generation = generation;
+        threadEvents.push_back(localEvents);
+    }
+    return *localEvents;
+}
+
+std::string quote(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            const char* hex = "0123456789abcdef";
+            out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+}
+
+Trace::Span::Span(Phase phase, const char* name) : phase(phase), name(name) {
+    if (modes.load(std::memory_order_relaxed)) {
+        startNs = nowNs();
+    }
+}
+
+Trace::Span::Span(Phase phase, const char* name, const std::string& detail) : phase(phase), name(name) {
+    unsigned current = modes.load(std::memory_order_relaxed);
+    if (current) {
+        if (current & TRACING) {
+            this->detail = detail;
+        }
+        startNs = nowNs();
+    }
+}
+
+Trace::Span::~Span() {
+    if (startNs < 0) {
+        return;
+    }
+    int64_t durationNs = nowNs() - startNs;
+    phaseNs[phase].fetch_add(static_cast<uint64_t>(durationNs), std::memory_order_relaxed);
+    phaseSpans[phase].fetch_add(1, std::memory_order_relaxed);
+    if (name && (modes.load(std::memory_order_relaxed) & TRACING)) {
+        ThreadEvents& events = eventsOfThread();
+        std::lock_guard<std::mutex> lock(events.mutex);
+        events.events.push_back({name, phase, startNs, durationNs, std::move(detail)});
+    }
+}
+
+void Trace::enableMetrics(bool enabled) {
+    if (enabled) {
+        modes |= METRICS;
+    } else {
+        modes &= ~METRICS;
+    }
+}
+
+Trace::Metrics Trace::metrics() {
+    Metrics result;
+    for (int i = 0; i < PhaseCount; i++) {
+        result.phaseNs[i] = phaseNs[i].load();
+        result.phaseSpans[i] = phaseSpans[i].load();
+    }
+    for (int i = 0; i < CounterCount; i++) {
+        result.counters[i] = counters[i].load();
+    }
+    return result;
+}
+
+void Trace::resetMetrics() {
+    for (int i = 0; i < PhaseCount; i++) {
+        phaseNs[i] = 0;
+        phaseSpans[i] = 0;
+    }
+    for (int i = 0; i < CounterCount; i++) {
+        counters[i] = 0;
+    }
+}
+
+void Trace::count(Counter counter, uint64_t amount) {
+    if (modes.load(std::memory_order_relaxed)) {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+const char* Trace::nameOf(Phase phase) {
+    return PHASE_NAMES[phase];
+}
+
+const char* Trace::nameOf(Counter counter) {
+    return COUNTER_NAMES[counter];
+}
+
+// Events recorded before are dropped
+void Trace::startTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    threadEvents.clear();
+    tracePath = path;
+    traceStartNs = nowNs();
+    traceGeneration++;
+    modes |= TRACING;
+}
+
+// Spans still open on other threads when the trace stops are left out
+void Trace::stopTrace() {
+    if (!(modes.fetch_and(~TRACING) & TRACING)) {
+        return;
+    }
+    std::vector<std::shared_ptr<ThreadEvents>> recorded;
+    std::string path;
+    int64_t startNs;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        recorded.swap(threadEvents);
+        path = tracePath;
+        startNs = traceStartNs;
+        traceGeneration++;
+    }
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Could not write trace: " << path << std::endl;
+        return;
+    }
+    out << std::fixed << std::setprecision(3); // Microseconds down to the nanosecond, however long the trace
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& thread : recorded) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        for (const Event& event : thread->events) {
+            out << (first ? "\n" : ",\n") << "{\"name\":" << quote(event.name) << ",\"cat\":\"" << nameOf(event.phase)
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->threadId
+                << ",\"ts\":" << (event.startNs - startNs) / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0;
+            if (!event.detail.empty()) {
+                out << ",\"args\":{\"path\":" << quote(event.detail) << "}";
+            }
+            out << "}";
+            first = false;
+        }
+    }
+    // The counters, as a single sample at the end of the trace
+    out << (first ? "\n" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+        << (nowNs() - startNs) / 1000.0 << ",\"args\":{";
+    for (int i = 0; i < CounterCount; i++) {
+        out << (i ? "," : "") << "\"" << COUNTER_NAMES[i] << "\":" << counters[i].load();
+    }
+    out << "}}\n]}\n";
+    if (!out) {
+        std::cerr << "Could not write trace: " << path << std::endl;
+    }
+}
+
+bool Trace::tracing() {
+    return modes.load(std::memory_order_relaxed) & TRACING;
+}
+
+void Trace::setVerbose(bool verbose) {
+    verboseLogging = verbose;
+}
+
+bool Trace::verbose() {
+    return verboseLogging.load(std::memory_order_relaxed);
+}
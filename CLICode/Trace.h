@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+// Instrumentation of the repository's work. Spans time the phases of an operation
+// (walking folders, stat'ing, reading, hashing, compressing, writing files and
+// metadata, comparing lines) and counters count what was done. Both are off until metrics or a trace
+// are enabled, and a span then costs two clock reads. While a trace is recorded,
+// every span is also kept as an event of the Chrome trace format, which
+// chrome://tracing and Perfetto open.
+class Trace {
+public:
+    // Operation: a whole repository operation; File: storing or restoring one file
+    enum Phase { Operation, File, Walk, Stat, Read, Hash, Compress, Write, Metadata, Compare, PhaseCount };
+    enum Counter {
+        FilesHashed, BytesHashed, StatCacheHits, StatCacheMisses, FilesStored, BytesStored, BytesWritten,
+        ObjectsReused, FilesRestored, BytesRestored, BlockCacheHits, BlockCacheMisses, CounterCount
+    };
+
+    // Totals since metrics were last reset. Phases nest (hashing a file includes
+    // reading it) and their times are summed over threads.
+    struct Metrics {
+        uint64_t phaseNs[PhaseCount] = {};
+        uint64_t phaseSpans[PhaseCount] = {};
+        uint64_t counters[CounterCount] = {};
+    };
+
+    // Times a phase from construction to destruction. `name` must outlive the trace
+    // (a literal); `detail`, such as the path worked on, is only copied when tracing.
+    // Spans without a name only add to their phase's time, for very frequent ones.
+    class Span {
+    public:
+        Span(Phase phase, const char* name);
+        Span(Phase phase, const char* name, const std::string& detail);
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    private:
+        Phase phase;
+        const char* name;
+        std::string detail;
+        int64_t startNs = -1; // -1 when instrumentation was off
+    };
+
+    static void enableMetrics(bool enabled);
+    static Metrics metrics();
+    static void resetMetrics();
+    static void count(Counter counter, uint64_t amount = 1);
+    static const char* nameOf(Phase phase);
+    static const char* nameOf(Counter counter);
+
+    // Record spans until stopTrace, which writes them with the counters to `path`
+    static void startTrace(const std::string& path);
+    static void stopTrace();
+    static bool tracing();
+
+    // Messages about each file worked on; off to keep large operations quiet and fast
+    static void setVerbose(bool verbose);
+    static bool verbose();
+};
+
+#endif // TRACE_H
@@ -1,19 +1,9 @@
 #include "Utils.h"
-#include <functional>
-#include <iostream>
+#include "Digest.h"
 
-// Hashes content using std::hash for demonstration (Replace with a robust hashing mechanism like SHA-256 in production)
+// Hashes content with SHA-256, which is stable across platforms and standard library builds
 std::string Utils::hashContent(const std::string& content) {
-    std::hash<std::string> hasher;
-    auto hashed = hasher(content); // This produces a size_t hash value
-    return std::to_string(hashed); // Convert to string for simplicity
-}
-
-// Placeholder function for monitoring directory changes
-void Utils::monitorDirectoryChanges(const std::string& directoryPath) {
-    // Implement file monitoring using platform-specific APIs like ReadDirectoryChangesW on Windows or inotify on Linux.
-    std::cout << "Monitoring changes in directory: " << directoryPath << std::endl;
-
-    // Placeholder code - Replace with actual implementation
-    // This is where you'd set up the file monitoring, handle events, etc.
+    std::unique_ptr<Digest> hasher = Digest::create(Digest::Strong);
+    hasher->update(content.data(), content.size());
+    return hasher->hexDigest();
 }
@@ -42,22 +42,108 @@ void VersionControlSystem::addDirectory(const std::string& foldername) {
     std::cout << foldername << " added to the repository." << std::endl;
 }
 
+// Add files and folders in one step, saving the repository once
+void VersionControlSystem::addMany(const std::vector<std::string>& paths) {
+    repo.trackMany(paths);
+    std::cout << paths.size() << " files and folders added to the repository." << std::endl;
+}
+
+// Stop tracking a file or folder (remove command)
+void VersionControlSystem::remove(const std::string& filename) {
+    repo.untrackFile(filename);
+}
+
 // Commit changes to the repository (commit command)
 void VersionControlSystem::commit() {
     repo.updateCommit();
     std::cout << "Changes committed to the repository." << std::endl;
 }
 
-void VersionControlSystem::rollback(int version) {
-    repo.rollbackToVersion(version);
+// Restore a version, or only some of its files and folders
+void VersionControlSystem::rollback(int version, const std::vector<std::string>& paths) {
+    repo.rollbackToVersion(version, paths);
     std::cout << "Changes committed to the repository." << std::endl;
 }
 
+// Store the history as deltas between consecutive versions of each file
+void VersionControlSystem::repack() {
+    repo.repack();
+}
+
+// Write the files of a version into a zip archive
+void VersionControlSystem::exportVersion(int version, const std::string& zipPath) {
+    repo.exportVersion(version, zipPath);
+}
+
+// Choose the codec and level used for files with an extension ("*" for all others)
+void VersionControlSystem::setCompression(const std::string& extension, const std::string& codec, int level) {
+    repo.setCompression(extension, codec, level);
+}
+
+// Follow the operations run from now on, for example from a Job
+void VersionControlSystem::setProgress(Progress* progress) {
+    repo.setProgress(progress);
+}
+
+// Keep statuses current by following file changes; refresh then only hashes changed files
+void VersionControlSystem::watch(FileWatcher::Listener listener) {
+    repo.watch(std::move(listener));
+}
+
+// Committed versions, oldest first (log command)
+std::vector<VersionInfo> VersionControlSystem::log() {
+    return repo.versions();
+}
+
+// Versions that changed a file, or a file inside a folder
+std::vector<VersionInfo> VersionControlSystem::log(const std::string& path) {
+    return repo.history(path);
+}
+
+// Changed lines between two versions, or between a version and the working files (diff command)
+std::vector<FileDiff> VersionControlSystem::diff(int fromVersion, int toVersion, const std::vector<std::string>& paths) {
+    return repo.diff(fromVersion, toVersion, paths);
+}
+
+// Read-only view of a committed version (show command)
+Snapshot VersionControlSystem::open(int version) {
+    return repo.snapshot(version);
+}
+
+// Name a version (tag command)
+void VersionControlSystem::tag(int version, const std::string& name) {
+    repo.tag(version, name);
+}
+
+void VersionControlSystem::untag(const std::string& name) {
+    repo.untag(name);
+}
+
+std::map<std::string, int> VersionControlSystem::tags() {
+    return repo.tags();
+}
+
+// One round of pruning and packing the history (gc command)
+GarbageReport VersionControlSystem::collectGarbage(const RetentionPolicy& policy, uint64_t budget) {
+    return repo.collectGarbage(policy, budget);
+}
+
+// Name recorded with the next commits
+void VersionControlSystem::setAuthor(const std::string& author) {
+    repo.setAuthor(author);
+}
+
 // Display status of the repository (status command)
 std::vector<bool> VersionControlSystem::status() {
     try {
         return repo.showStatus();
     } catch (const std::exception& e) {
         std::cerr << "Failed to retrieve status: " << e.what() << std::endl;
+        throw; // Callers report it: the CLI as its JSON error, the GUI in a message box
     }
 }
+
+// Files changed inside a tracked folder since its last commit
+std::vector<std::string> VersionControlSystem::modifiedFiles(const std::string& foldername) {
+    return repo.modifiedFiles(foldername);
+}
@@ -11,11 +11,29 @@ public:
     void init();
     void add(const std::string& filename);
     void addDirectory(const std::string& foldername);
+    void addMany(const std::vector<std::string>& paths);
+    void remove(const std::string& filename);
     void commit();
+    void setAuthor(const std::string& author);
     void refresh();
     std::vector<bool> status();
+    std::vector<std::string> modifiedFiles(const std::string& foldername);
     int getVersion();
-    void rollback(int version);
+    void rollback(int version, const std::vector<std::string>& paths = {});
+    void repack();
+    void exportVersion(int version, const std::string& zipPath);
+    std::vector<VersionInfo> log();
+    std::vector<VersionInfo> log(const std::string& path);
+    std::vector<FileDiff> diff(int fromVersion, int toVersion = Repository::WORKING_FILES,
+                               const std::vector<std::string>& paths = {});
+    Snapshot open(int version);
+    void tag(int version, const std::string& name);
+    void untag(const std::string& name);
+    std::map<std::string, int> tags();
+    GarbageReport collectGarbage(const RetentionPolicy& policy, uint64_t budget = Repository::GC_ROUND_BYTES);
+    void setCompression(const std::string& extension, const std::string& codec, int level);
+    void setProgress(Progress* progress);
+    void watch(FileWatcher::Listener listener);
 private:
     Repository repo;
 };
@@ -10,20 +10,62 @@ CONFIG += c++17
 
 SOURCES += \
     CLICode/AuthenticationSystem.cpp \
+    CLICode/CommitLog.cpp \
+    CLICode/CompressionPolicy.cpp \
+    CLICode/Delta.cpp \
+    CLICode/Diff.cpp \
+    CLICode/Digest.cpp \
     CLICode/FileHandler.cpp \
+    CLICode/FileWatcher.cpp \
+    CLICode/Job.cpp \
+    CLICode/Journal.cpp \
+    CLICode/MerkleTree.cpp \
+    CLICode/ObjectStore.cpp \
+    CLICode/PathIndex.cpp \
+    CLICode/Progress.cpp \
+    CLICode/RecordIndex.cpp \
     CLICode/Repository.cpp \
+    CLICode/RepositoryCache.cpp \
+    CLICode/Snapshot.cpp \
+    CLICode/StatCache.cpp \
+    CLICode/ThreadPool.cpp \
+    CLICode/Trace.cpp \
     CLICode/Utils.cpp \
     CLICode/VersionControlSystem.cpp \
+    diffview.cpp \
+    fileview.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    statusmodel.cpp
 
 HEADERS += \
     CLICode/AuthenticationSystem.h \
+    CLICode/CommitLog.h \
+    CLICode/CompressionPolicy.h \
+    CLICode/Delta.h \
+    CLICode/Diff.h \
+    CLICode/Digest.h \
     CLICode/FileHandler.h \
+    CLICode/FileWatcher.h \
+    CLICode/Job.h \
+    CLICode/Journal.h \
+    CLICode/MerkleTree.h \
+    CLICode/ObjectStore.h \
+    CLICode/PathIndex.h \
+    CLICode/Progress.h \
+    CLICode/RecordIndex.h \
     CLICode/Repository.h \
+    CLICode/RepositoryCache.h \
+    CLICode/Snapshot.h \
+    CLICode/StatCache.h \
+    CLICode/ThreadPool.h \
+    CLICode/Trace.h \
     CLICode/Utils.h \
     CLICode/VersionControlSystem.h \
-    mainwindow.h
+    diffview.h \
+    fileview.h \
+    mainwindow.h \
+    statusmodel.h
 
 FORMS += \
     mainwindow.ui
@@ -34,7 +76,8 @@ INCLUDEPATH += "C:/Program Files/OpenSSL-Win64/include" \
 LIBS += -L"C:/Program Files/OpenSSL-Win64/lib" \
         -llibcrypto \
         -LC:/msys64/mingw64/lib \
-        -lminizip
+        -lminizip \
+        -lz
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,77 @@
+#include "Benchmarks.h"
+#include "PathIndex.h"
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t SAMPLE_SIZE = 1000; // Additions timed at each size
+
+// Path of the i-th tracked file, spread over nested folders like a source tree
+std::string pathOf(size_t i) {
+    return "/repo/module" + std::to_string(i % 97) + "/dir" + std::to_string(i % 1009) + "/file" + std::to_string(i) + ".cpp";
+}
+
+// The conflict checks and bookkeeping trackMany does for one new file
+void addIndexed(PathIndex& index, const std::string& path, size_t position) {
+    if (!index.trackedAncestor(path).empty()) {
+        throw std::runtime_error("Unexpected conflict: " + path);
+    }
+    index.insert(path, position);
+}
+
+// The scan trackFile did before the index: every tracked path is compared
+void addLinear(std::vector<std::string>& tracked, const std::string& path) {
+    for (const auto& trackedPath : tracked) {
+        if (path.compare(0, trackedPath.size(), trackedPath) == 0) {
+            throw std::runtime_error("Unexpected conflict: " + path);
+        }
+    }
+    tracked.push_back(path);
+}
+
+}
+
+// Latency of adding one file as the tracked set grows, with the path index and
+// with a linear scan. The scan is only measured up to `linearLimit` entries.
+int runAddBenchmark(const std::vector<std::string>& args) {
+    size_t maxEntries = args.size() > 0 ? std::stoull(args[0]) : 1000000;
+    size_t linearLimit = args.size() > 1 ? std::stoull(args[1]) : 100000;
+
+    PathIndex index;
+    std::vector<std::string> tracked;
+    size_t added = 0;
+
+    std::cout << "structure,entries,ns_per_add" << std::endl;
+    for (size_t entries = 1000; entries <= maxEntries; entries *= 10) {
+        // Grow to the next size, then time a sample of additions on top of it
+        for (; added < entries; added++) {
+            index.insert(pathOf(added), added);
+            if (entries <= linearLimit) tracked.push_back(pathOf(added));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < SAMPLE_SIZE; i++) {
+            addIndexed(index, pathOf(added + i), added + i);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "path_index," << entries << "," << elapsed.count() / SAMPLE_SIZE << std::endl;
+        for (size_t i = 0; i < SAMPLE_SIZE; i++) {
+            index.erase(pathOf(added + i));
+        }
+
+        if (entries <= linearLimit) {
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < SAMPLE_SIZE; i++) {
+                addLinear(tracked, pathOf(added + i));
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "linear_scan," << entries << "," << elapsed.count() / SAMPLE_SIZE << std::endl;
+            tracked.resize(entries);
+        }
+    }
+    return 0;
+}
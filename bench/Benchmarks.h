@@ -0,0 +1,13 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+#include <vector>
+
+// Each benchmark takes the arguments following its name on the command line
+// and prints one CSV row per measurement to standard output.
+int runHashBenchmark(const std::vector<std::string>& args);
+int runAddBenchmark(const std::vector<std::string>& args);
+int runRepositoryBenchmark(const std::vector<std::string>& args);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,64 @@
+#include "Benchmarks.h"
+#include "Digest.h"
+#include "FileHandler.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+namespace {
+
+const size_t BUFFER_SIZE = 256 * 1024 * 1024; // Large enough to defeat the CPU caches
+const size_t UPDATE_SIZE = 1024 * 1024;       // Matches how callers feed data in practice
+
+void printRow(const std::string& mode, Digest::Algorithm algorithm, double bytes, double seconds) {
+    std::cout << mode << "," << Digest::idOf(algorithm) << "," << static_cast<long long>(bytes) << ","
+              << seconds << "," << bytes / seconds / 1e9 << std::endl;
+}
+
+}
+
+// Throughput of every digest algorithm over an in-memory buffer, and optionally
+// end to end through FileHandler::hashFile on an existing (large) file.
+int runHashBenchmark(const std::vector<std::string>& args) {
+    double gigabytes = args.size() > 0 ? std::stod(args[0]) : 4.0;
+    const size_t totalBytes = static_cast<size_t>(gigabytes * 1e9);
+
+    std::vector<char> buffer(BUFFER_SIZE);
+    std::mt19937_64 generator(42);
+    for (size_t i = 0; i + sizeof(uint64_t) <= buffer.size(); i += sizeof(uint64_t)) {
+        uint64_t value = generator();
+        std::copy(reinterpret_cast<char*>(&value), reinterpret_cast<char*>(&value) + sizeof(value), buffer.begin() + i);
+    }
+
+    std::cout << "mode,algorithm,bytes,seconds,GB/s" << std::endl;
+    for (Digest::Algorithm algorithm : {Digest::Fast, Digest::Strong, Digest::Legacy}) {
+        // std::hash buffers everything it is given, so it only sees the buffer once
+        size_t bytesToHash = algorithm == Digest::Legacy ? buffer.size() : totalBytes;
+        std::unique_ptr<Digest> digest = Digest::create(algorithm);
+
+        auto start = std::chrono::steady_clock::now();
+        size_t hashed = 0;
+        while (hashed < bytesToHash) {
+            size_t offset = hashed % buffer.size();
+            size_t length = std::min({UPDATE_SIZE, buffer.size() - offset, bytesToHash - hashed});
+            digest->update(buffer.data() + offset, length);
+            hashed += length;
+        }
+        digest->hexDigest();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printRow("memory", algorithm, static_cast<double>(hashed), elapsed.count());
+    }
+
+    if (args.size() > 1) {
+        const std::string& path = args[1];
+        for (Digest::Algorithm algorithm : {Digest::Fast, Digest::Strong}) {
+            auto start = std::chrono::steady_clock::now();
+            FileHandler::hashFile(path, algorithm);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            printRow("file", algorithm, static_cast<double>(std::filesystem::file_size(path)), elapsed.count());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "Benchmarks.h"
+#include "Repository.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const size_t SMALL_FILES = 10000;              // "small": flat folder of 512 B to 4 KB text files
+const size_t HUGE_FILES = 4;                   // "huge": 64 MB files, half text and half binary
+const size_t HUGE_FILE_SIZE = 64 * 1024 * 1024;
+const size_t DEEP_TREES = 8;                   // "deep": binary folder trees 8 levels deep
+const int DEEP_LEVELS = 8;
+const size_t MIXED_FOLDERS = 20;               // "mixed": folders of text, binary and compressed files
+const size_t MIXED_FILES = 100;
+const size_t CHANGE_EVERY = 100;               // One file in 100 is modified between commits
+
+using Clock = std::chrono::steady_clock;
+
+// A generated tree: the entries tracked one by one at its root, and every file below them
+struct Tree {
+    std::vector<std::string> entries;
+    std::vector<std::string> files;
+    uintmax_t bytes = 0;
+};
+
+// Timings of one operation over every iteration
+struct Measure {
+    std::vector<double> samples; // Seconds
+    size_t files = 0;            // Per iteration
+    uintmax_t bytes = 0;         // Per iteration
+};
+
+// Source-like lines, compressible the way real text is
+void writeText(const std::string& path, size_t size, std::mt19937_64& generator) {
+    static const char* words[] = {"int", "return", "value", "std::string", "for", "if", "const", "auto", "size_t",
+                                  "path", "records", "=", "+", "(", ")", "{", "}", ";", "// comment", "version"};
+    std::string text;
+    text.reserve(size + 64);
+    while (text.size() < size) {
+        text += words[generator() % 20];
+        text += generator() % 8 == 0 ? '\n' : ' ';
+    }
+    text.resize(size);
+    std::ofstream(path, std::ios::binary).write(text.data(), text.size());
+}
+
+// Random bytes, which do not compress
+void writeBinary(const std::string& path, size_t size, std::mt19937_64& generator) {
+    std::ofstream file(path, std::ios::binary);
+    std::vector<uint64_t> chunk(64 * 1024);
+    for (size_t written = 0; written < size;) {
+        std::generate(chunk.begin(), chunk.end(), std::ref(generator));
+        size_t length = std::min(size - written, chunk.size() * sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(chunk.data()), length);
+        written += length;
+    }
+}
+
+void addFile(Tree& tree, const std::string& path, size_t size, bool binary, std::mt19937_64& generator) {
+    binary ? writeBinary(path, size, generator) : writeText(path, size, generator);
+    tree.files.push_back(path);
+    tree.bytes += size;
+}
+
+void generateDeep(Tree& tree, const std::string& folder, int levels, std::mt19937_64& generator) {
+    fs::create_directories(folder);
+    for (int i = 0; i < 2; i++) {
+        addFile(tree, folder + "/file" + std::to_string(i) + ".txt", 1024 + generator() % 8192, false, generator);
+    }
+    if (levels > 1) {
+        generateDeep(tree, folder + "/left", levels - 1, generator);
+        generateDeep(tree, folder + "/right", levels - 1, generator);
+    }
+}
+
+// Write the files of a scenario under `root`, with counts and sizes multiplied by `scale`
+Tree generate(const std::string& scenario, const std::string& root, double scale) {
+    Tree tree;
+    std::mt19937_64 generator(42);
+    auto scaled = [scale](size_t count) { return std::max<size_t>(1, static_cast<size_t>(count * scale)); };
+    fs::create_directories(root);
+    if (scenario == "small") {
+        for (size_t i = 0; i < scaled(SMALL_FILES); i++) {
+            std::string path = root + "/file" + std::to_string(i) + ".txt";
+            addFile(tree, path, 512 + generator() % 3584, false, generator);
+            tree.entries.push_back(path);
+        }
+    } else if (scenario == "huge") {
+        for (size_t i = 0; i < HUGE_FILES; i++) {
+            std::string path = root + "/huge" + std::to_string(i) + (i % 2 ? ".bin" : ".log");
+            addFile(tree, path, scaled(HUGE_FILE_SIZE), i % 2 == 1, generator);
+            tree.entries.push_back(path);
+        }
+    } else if (scenario == "deep") {
+        for (size_t i = 0; i < scaled(DEEP_TREES); i++) {
+            std::string folder = root + "/tree" + std::to_string(i);
+            generateDeep(tree, folder, DEEP_LEVELS, generator);
+            tree.entries.push_back(folder);
+        }
+    } else if (scenario == "mixed") {
+        for (size_t i = 0; i < scaled(MIXED_FOLDERS); i++) {
+            std::string folder = root + "/folder" + std::to_string(i);
+            fs::create_directories(folder);
+            for (size_t j = 0; j < MIXED_FILES; j++) {
+                size_t size = 1024 + generator() % (j % 10 == 0 ? 1024 * 1024 : 32 * 1024);
+                std::string name = folder + "/file" + std::to_string(j);
+                switch (j % 4) {
+                case 0: addFile(tree, name + ".bin", size, true, generator); break;
+                case 1: addFile(tree, name + ".png", size, true, generator); break; // Stored as it is
+                default: addFile(tree, name + ".cpp", size, false, generator); break;
+                }
+            }
+            tree.entries.push_back(folder);
+        }
+    } else {
+        throw std::runtime_error("Unknown scenario: " + scenario);
+    }
+
+    // Files changed in the last seconds are always hashed again, which a real tree avoids
+    auto past = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const std::string& path : tree.files) {
+        fs::last_write_time(path, past);
+    }
+    return tree;
+}
+
+// Append a line to one file in CHANGE_EVERY, starting at `offset`; returns the bytes of the changed files
+uintmax_t modify(const Tree& tree, size_t offset, size_t& files) {
+    uintmax_t bytes = 0;
+    files = 0;
+    for (size_t i = offset % CHANGE_EVERY; i < tree.files.size(); i += CHANGE_EVERY) {
+        std::ofstream(tree.files[i], std::ios::binary | std::ios::app) << "changed\n";
+        bytes += fs::file_size(tree.files[i]);
+        files++;
+    }
+    if (files == 0) {
+        return modify(tree, 0, files);
+    }
+    return bytes;
+}
+
+// Leave the tree as generated, without repository
+void removeMetadata(const std::string& root) {
+    for (const std::string& path : Repository::metadataPaths(root)) {
+        fs::remove(path);
+    }
+    fs::remove_all(root + "/history");
+}
+
+// High-water mark of the process's resident memory, in KB
+long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // KB on Linux
+#endif
+}
+
+template <typename Operation>
+void timed(Measure& measure, Operation operation) {
+    auto start = Clock::now();
+    operation();
+    measure.samples.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+void printRow(std::ostream& out, const std::string& scenario, const std::string& operation, const Measure& measure,
+              size_t iterations) {
+    std::vector<double> sorted = measure.samples;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double sample : sorted) total += sample;
+    double bytes = static_cast<double>(measure.bytes) * iterations;
+    out << scenario << "," << operation << "," << sorted.size() << "," << measure.files << "," << measure.bytes << ","
+        << total / sorted.size() * 1e3 << "," << percentile(sorted, 0.5) * 1e3 << ","
+        << percentile(sorted, 0.9) * 1e3 << "," << percentile(sorted, 0.99) * 1e3 << "," << sorted.back() * 1e3 << ","
+        << (total > 0 ? bytes / total / 1e6 : 0) << "," << peakRssKb() << std::endl;
+}
+
+// Every operation of a scenario, `iterations` times on a fresh repository over the same tree
+void runScenario(const std::string& scenario, const std::string& folder, double scale, size_t iterations,
+                 std::ostream& out) {
+    std::string root = folder + "/" + scenario;
+    fs::remove_all(root);
+    Tree tree = generate(scenario, root, scale);
+
+    Measure init, track, update, status, commitFull, commitIncremental, rollback;
+    track.files = commitFull.files = tree.files.size();
+    track.bytes = commitFull.bytes = tree.bytes;
+    for (size_t i = 0; i < iterations; i++) {
+        removeMetadata(root);
+        std::unique_ptr<Repository> repo;
+        timed(init, [&]() {
+            repo = std::make_unique<Repository>(root);
+            repo->initializeRepository(false);
+        });
+        // One sample per call, since each call is what a user waits for
+        for (const std::string& entry : tree.entries) {
+            timed(track, [&]() { fs::is_directory(entry) ? repo->trackFolder(entry) : repo->trackFile(entry); });
+        }
+
+        // A commit needs changes, so the first one stores the modified tree
+        update.bytes = modify(tree, 2 * i, update.files);
+        timed(update, [&]() { repo->update(); });
+        status.files = tree.entries.size();
+        timed(status, [&]() { repo->showStatus(); });
+        timed(commitFull, [&]() { repo->updateCommit(); });
+
+        commitIncremental.bytes = modify(tree, 2 * i + 1, commitIncremental.files);
+        timed(commitIncremental, [&]() { repo->updateCommit(); });
+        rollback.files = commitIncremental.files;
+        rollback.bytes = commitIncremental.bytes;
+        timed(rollback, [&]() { repo->rollbackToVersion(0); });
+    }
+    printRow(out, scenario, "init", init, iterations);
+    printRow(out, scenario, "track", track, iterations);
+    printRow(out, scenario, "update", update, iterations);
+    printRow(out, scenario, "status", status, iterations);
+    printRow(out, scenario, "commit_full", commitFull, iterations);
+    printRow(out, scenario, "commit_incremental", commitIncremental, iterations);
+    printRow(out, scenario, "rollback", rollback, iterations);
+    fs::remove_all(root);
+}
+
+}
+
+// Latency and throughput of the repository operations over synthetic trees. Every
+// operation is timed once per iteration, except tracking which is timed per call.
+// Files and bytes are those an operation had to process in one iteration, and the
+// peak RSS is the process's high-water mark so far, so scenarios are best compared
+// one per run.
+int runRepositoryBenchmark(const std::vector<std::string>& args) {
+    std::string scenario = args.size() > 0 ? args[0] : "all";
+    double scale = args.size() > 1 ? std::stod(args[1]) : 1.0;
+    size_t iterations = args.size() > 2 ? std::stoull(args[2]) : 5;
+    std::string folder = args.size() > 3 ? args[3] : (fs::temp_directory_path() / "vcs_bench").string();
+    if (iterations == 0) {
+        throw std::runtime_error("At least one iteration is needed");
+    }
+
+    // The repository reports on std::cout as it goes, which would mix with the rows;
+    // messages about each file are left out, as they would weigh on the timings
+    Trace::setVerbose(false);
+    std::ostream out(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+    try {
+        out << "scenario,operation,samples,files,bytes,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,MB/s,peak_rss_kb"
+            << std::endl;
+        std::vector<std::string> scenarios = {"small", "huge", "deep", "mixed"};
+        if (scenario != "all") {
+            scenarios = {scenario};
+        }
+        for (const std::string& name : scenarios) {
+            runScenario(name, folder, scale, iterations, out);
+        }
+    } catch (...) {
+        std::cout.rdbuf(out.rdbuf());
+        throw;
+    }
+    std::cout.rdbuf(out.rdbuf());
+    return 0;
+}
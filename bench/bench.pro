@@ -0,0 +1,46 @@
+TEMPLATE = app
+TARGET = vcsBench
+CONFIG += console c++17
+CONFIG -= app_bundle
+QT -= core gui
+
+INCLUDEPATH += ../CLICode \
+               "C:/Program Files/OpenSSL-Win64/include" \
+               "C:/msys64/mingw64/include"
+
+SOURCES += \
+    ../CLICode/CommitLog.cpp \
+    ../CLICode/CompressionPolicy.cpp \
+    ../CLICode/Delta.cpp \
+    ../CLICode/Diff.cpp \
+    ../CLICode/Digest.cpp \
+    ../CLICode/FileHandler.cpp \
+    ../CLICode/FileWatcher.cpp \
+    ../CLICode/Journal.cpp \
+    ../CLICode/MerkleTree.cpp \
+    ../CLICode/ObjectStore.cpp \
+    ../CLICode/PathIndex.cpp \
+    ../CLICode/Progress.cpp \
+    ../CLICode/RecordIndex.cpp \
+    ../CLICode/Repository.cpp \
+    ../CLICode/Snapshot.cpp \
+    ../CLICode/StatCache.cpp \
+    ../CLICode/ThreadPool.cpp \
+    ../CLICode/Trace.cpp \
+    ../CLICode/Utils.cpp \
+    AddBenchmark.cpp \
+    HashBenchmark.cpp \
+    RepositoryBenchmark.cpp \
+    main.cpp
+
+HEADERS += \
+    Benchmarks.h
+
+LIBS += -L"C:/Program Files/OpenSSL-Win64/lib" \
+        -llibcrypto \
+        -LC:/msys64/mingw64/lib \
+        -lminizip \
+        -lz
+
+win32: LIBS += -lpsapi
+unix: LIBS += -lpthread
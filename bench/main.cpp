@@ -0,0 +1,30 @@
+#include "Benchmarks.h"
+#include <iostream>
+#include <stdexcept>
+
+// Usage: vcsBench <benchmark> [arguments...]
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " hash [gigabytes] [file]" << std::endl;
+        std::cerr << "       " << argv[0] << " add [entries] [linear entries]" << std::endl;
+        std::cerr << "       " << argv[0] << " repo [small|huge|deep|mixed|all] [scale] [iterations] [folder]" << std::endl;
+        return 1;
+    }
+
+    std::string benchmark = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+    try {
+        if (benchmark == "hash") {
+            return runHashBenchmark(args);
+        } else if (benchmark == "add") {
+            return runAddBenchmark(args);
+        } else if (benchmark == "repo") {
+            return runRepositoryBenchmark(args);
+        }
+        std::cerr << "Unknown benchmark: " << benchmark << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,411 @@
+#include "Trace.h"
+#include "VersionControlSystem.h"
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char* USAGE =
+    "Usage: mvcsApp [--repo <path>] [--quiet] [--metrics] [--trace <file>] <command> [arguments...]\n"
+    "  init [path]                    Create a repository (the current folder by default)\n"
+    "  add <files and folders...>     Track files and folders\n"
+    "  add-dir <folder>               Track a folder\n"
+    "  commit [--author <name>]       Commit the changed files as a new version\n"
+    "  status                         Refresh and list the tracked files with their status\n"
+    "  rollback <version> [paths...]  Restore a version, or only some of its files and folders\n"
+    "  log [path]                     List the committed versions, or those that changed a file or folder\n"
+    "  diff <version>[..<version>] [paths...]\n"
+    "                                 Changed lines since a version, or between two versions\n"
+    "  show <version> [path] [--range <offset>,<length>] [--output <file>]\n"
+    "                                 List the files of a version, or read one without touching the working files\n"
+    "  tag [<version> <name> | --delete <name>]\n"
+    "                                 Name a version, remove a name, or list the names\n"
+    "  gc [--keep-last <n>] [--keep-since <date>]\n"
+    "                                 Remove older versions, except tagged ones, and pack what is left\n"
+    "Options:\n"
+    "  --quiet                        No messages about each file on stderr\n"
+    "  --metrics                      Add the time of each phase and the counters to the result\n"
+    "  --trace <file>                 Write a Chrome trace (chrome://tracing, Perfetto) of the command\n";
+
+// Quoted JSON string
+std::string quote(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (c < 0x20) {
+                const char* hex = "0123456789abcdef";
+                out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+std::string quoteAll(const std::vector<std::string>& texts) {
+    std::string list = "[";
+    for (size_t i = 0; i < texts.size(); i++) {
+        list += (i ? "," : "") + quote(texts[i]);
+    }
+    return list + "]";
+}
+
+// ISO 8601 in UTC
+std::string formatTime(int64_t timeNs) {
+    std::time_t seconds = static_cast<std::time_t>(timeNs / 1000000000);
+    std::tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return text;
+}
+
+// Nanoseconds since the epoch of a date, YYYY-MM-DD (midnight UTC), or of seconds since the epoch
+int64_t parseTime(const std::string& text) {
+    int year = 0, month = 0, day = 0;
+    char dash1 = 0, dash2 = 0;
+    std::istringstream date(text);
+    if (date >> year >> dash1 >> month >> dash2 >> day && dash1 == '-' && dash2 == '-' && date.eof()) {
+        // Days from 1970-01-01 in the proleptic Gregorian calendar
+        int y = month <= 2 ? year - 1 : year;
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yearOfEra = y - era * 400;
+        int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+        return days * 86400 * 1000000000LL;
+    }
+    size_t end = 0;
+    int64_t seconds = std::stoll(text, &end);
+    if (end != text.size()) throw std::invalid_argument("Not a date: " + text);
+    return seconds * 1000000000LL;
+}
+
+// Records are absolute paths, so arguments are made absolute the same way
+std::string absolutePath(const std::string& path) {
+    std::filesystem::path normal = std::filesystem::absolute(path).lexically_normal();
+    if (!normal.has_filename() && normal.has_relative_path()) {
+        normal = normal.parent_path(); // "folder/" from "folder/."
+    }
+    return normal.string();
+}
+
+std::vector<std::string> absolutePaths(const std::vector<std::string>& paths) {
+    std::vector<std::string> result;
+    for (const std::string& path : paths) {
+        result.push_back(absolutePath(path));
+    }
+    return result;
+}
+
+VersionControlSystem openRepository(const std::string& repoPath) {
+    if (!Repository::isRepository(repoPath)) {
+        throw std::runtime_error("Not a repository: " + repoPath);
+    }
+    return VersionControlSystem(repoPath);
+}
+
+// Phase times and counters of the command, as a JSON object
+std::string metricsJson() {
+    Trace::Metrics metrics = Trace::metrics();
+    std::ostringstream out;
+    out << "{\"phases\":{";
+    for (int i = 0; i < Trace::PhaseCount; i++) {
+        out << (i ? "," : "") << quote(Trace::nameOf(static_cast<Trace::Phase>(i))) << ":{\"ms\":"
+            << metrics.phaseNs[i] / 1e6 << ",\"spans\":" << metrics.phaseSpans[i] << "}";
+    }
+    out << "},\"counters\":{";
+    for (int i = 0; i < Trace::CounterCount; i++) {
+        out << (i ? "," : "") << quote(Trace::nameOf(static_cast<Trace::Counter>(i))) << ":" << metrics.counters[i];
+    }
+    out << "}}";
+    return out.str();
+}
+
+// Runs a command and writes its result as one JSON object to `out`
+void runCommand(const std::string& command, std::string repoPath, const std::vector<std::string>& args, std::ostream& out) {
+    if (command == "init") {
+        if (args.size() > 1) throw std::invalid_argument("init takes at most one path");
+        if (!args.empty()) repoPath = absolutePath(args[0]);
+        if (Repository::isRepository(repoPath)) {
+            throw std::runtime_error("Already a repository: " + repoPath);
+        }
+        std::filesystem::create_directories(repoPath);
+        VersionControlSystem vcs(repoPath);
+        vcs.init();
+        out << "{\"command\":\"init\",\"repository\":" << quote(repoPath) << "}";
+    } else if (command == "add" || command == "add-dir") {
+        if (args.empty() || (command == "add-dir" && args.size() != 1)) {
+            throw std::invalid_argument(command + " needs " + (command == "add" ? "files or folders" : "one folder"));
+        }
+        VersionControlSystem vcs = openRepository(repoPath);
+        std::vector<std::string> paths = absolutePaths(args);
+        if (command == "add") {
+            vcs.addMany(paths);
+        } else {
+            vcs.addDirectory(paths[0]);
+        }
+        out << "{\"command\":" << quote(command) << ",\"added\":" << quoteAll(paths) << "}";
+    } else if (command == "commit") {
+        if (!args.empty() && (args.size() != 2 || args[0] != "--author")) {
+            throw std::invalid_argument("commit takes only --author <name>");
+        }
+        VersionControlSystem vcs = openRepository(repoPath);
+        if (!args.empty()) vcs.setAuthor(args[1]);
+        vcs.commit();
+        out << "{\"command\":\"commit\",\"version\":" << vcs.getVersion() - 1 << "}";
+    } else if (command == "status") {
+        if (!args.empty()) throw std::invalid_argument("status takes no arguments");
+        VersionControlSystem vcs = openRepository(repoPath);
+        vcs.refresh();
+        std::vector<std::string> files = vcs.getFiles();
+        std::vector<bool> modified = vcs.status();
+        out << "{\"command\":\"status\",\"version\":" << vcs.getVersion() << ",\"files\":[";
+        for (size_t i = 0; i < files.size(); i++) {
+            bool changed = i < modified.size() && modified[i];
+            out << (i ? "," : "") << "{\"path\":" << quote(files[i])
+                << ",\"status\":" << (changed ? "\"modified\"" : "\"up-to-date\"");
+            if (changed && std::filesystem::is_directory(files[i])) {
+                out << ",\"changed\":" << quoteAll(vcs.modifiedFiles(files[i]));
+            }
+            out << "}";
+        }
+        out << "]}";
+    } else if (command == "rollback") {
+        if (args.empty()) throw std::invalid_argument("rollback needs a version");
+        int version = std::stoi(args[0]);
+        std::vector<std::string> paths = absolutePaths({args.begin() + 1, args.end()});
+        VersionControlSystem vcs = openRepository(repoPath);
+        vcs.rollback(version, paths);
+        out << "{\"command\":\"rollback\",\"version\":" << version << ",\"paths\":" << quoteAll(paths) << "}";
+    } else if (command == "log") {
+        if (args.size() > 1) throw std::invalid_argument("log takes at most one path");
+        VersionControlSystem vcs = openRepository(repoPath);
+        out << "{\"command\":\"log\",";
+        if (!args.empty()) out << "\"path\":" << quote(absolutePath(args[0])) << ",";
+        out << "\"versions\":[";
+        std::vector<VersionInfo> versions = args.empty() ? vcs.log() : vcs.log(absolutePath(args[0]));
+        for (size_t i = 0; i < versions.size(); i++) {
+            const VersionInfo& info = versions[i];
+            out << (i ? "," : "") << "{\"version\":" << info.version << ",\"parent\":" << info.parent
+                << ",\"files\":" << info.files << ",\"time\":" << quote(formatTime(info.timeNs))
+                << ",\"author\":" << quote(info.author) << ",\"bytes\":" << info.bytesChanged
+                << ",\"tags\":" << quoteAll(info.tags) << ",\"changes\":[";
+            for (size_t j = 0; j < info.changes.size(); j++) {
+                const FileChange& change = info.changes[j];
+                out << (j ? "," : "") << "{\"kind\":" << quote(std::string(1, static_cast<char>(change.kind)))
+                    << ",\"path\":" << quote(change.path) << ",\"size\":" << change.size << "}";
+            }
+            out << "]}";
+        }
+        out << "]}";
+    } else if (command == "diff") {
+        if (args.empty()) throw std::invalid_argument("diff needs a version");
+        size_t dots = args[0].find("..");
+        int fromVersion = std::stoi(args[0].substr(0, dots));
+        int toVersion = dots == std::string::npos ? Repository::WORKING_FILES : std::stoi(args[0].substr(dots + 2));
+        std::vector<std::string> paths = absolutePaths({args.begin() + 1, args.end()});
+        VersionControlSystem vcs = openRepository(repoPath);
+        std::vector<FileDiff> diffs = vcs.diff(fromVersion, toVersion, paths);
+        out << "{\"command\":\"diff\",\"from\":" << fromVersion << ",\"to\":"
+            << (toVersion == Repository::WORKING_FILES ? "\"working\"" : std::to_string(toVersion)) << ",\"files\":[";
+        for (size_t i = 0; i < diffs.size(); i++) {
+            const FileDiff& diff = diffs[i];
+            out << (i ? "," : "") << "{\"path\":" << quote(diff.path) << ",\"kind\":"
+                << quote(std::string(1, static_cast<char>(diff.kind))) << ",\"binary\":" << (diff.binary ? "true" : "false")
+                << ",\"hunks\":[";
+            for (size_t j = 0; j < diff.hunks.size(); j++) {
+                const DiffHunk& hunk = diff.hunks[j];
+                out << (j ? "," : "") << "{\"old_start\":" << hunk.oldStart << ",\"old_count\":" << hunk.oldCount
+                    << ",\"new_start\":" << hunk.newStart << ",\"new_count\":" << hunk.newCount << ",\"lines\":[";
+                for (size_t k = 0; k < hunk.lines.size(); k++) {
+                    out << (k ? "," : "") << quote(hunk.lines[k].kind + hunk.lines[k].text);
+                    if (!hunk.lines[k].newline) out << "," << quote("\\ No newline at end of file");
+                }
+                out << "]}";
+            }
+            out << "]}";
+        }
+        out << "]}";
+    } else if (command == "show") {
+        if (args.empty()) throw std::invalid_argument("show needs a version");
+        int version = std::stoi(args[0]);
+        std::string path, outputPath;
+        uint64_t offset = 0, length = UINT64_MAX;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (args[i] == "--output" && i + 1 < args.size()) {
+                outputPath = absolutePath(args[++i]);
+            } else if (args[i] == "--range" && i + 1 < args.size()) {
+                std::string range = args[++i];
+                size_t comma = range.find(',');
+                if (comma == std::string::npos) throw std::invalid_argument("--range takes <offset>,<length>");
+                offset = std::stoull(range.substr(0, comma));
+                length = std::stoull(range.substr(comma + 1));
+            } else if (path.empty() && args[i].rfind("--", 0) != 0) {
+                path = absolutePath(args[i]);
+            } else {
+                throw std::invalid_argument("show takes a version, a path, --range and --output");
+            }
+        }
+        VersionControlSystem vcs = openRepository(repoPath);
+        Snapshot snapshot = vcs.open(version);
+        out << "{\"command\":\"show\",\"version\":" << version;
+        if (path.empty() || !snapshot.contains(path)) {
+            if (!outputPath.empty() || length != UINT64_MAX) {
+                throw std::invalid_argument("--range and --output need a file");
+            }
+            std::vector<std::string> files = snapshot.list(path);
+            if (!path.empty() && files.empty()) {
+                throw std::runtime_error("Version " + std::to_string(version) + " has no file or folder " + path);
+            }
+            out << ",\"files\":" << quoteAll(files) << "}";
+            return;
+        }
+        uint64_t size = snapshot.size(path);
+        out << ",\"path\":" << quote(path) << ",\"size\":" << size;
+        if (!outputPath.empty() && length == UINT64_MAX && offset == 0) {
+            snapshot.extract(path, outputPath);
+            out << ",\"output\":" << quote(outputPath) << "}";
+            return;
+        }
+        std::string content(static_cast<size_t>(std::min(length, offset < size ? size - offset : 0)), '\0');
+        content.resize(snapshot.read(path, offset, &content[0], content.size()));
+        if (!outputPath.empty()) {
+            std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+            output.write(content.data(), content.size());
+            if (!output) throw std::runtime_error("Could not write file: " + outputPath);
+            out << ",\"offset\":" << offset << ",\"output\":" << quote(outputPath) << "}";
+        } else {
+            out << ",\"offset\":" << offset << ",\"content\":" << quote(content) << "}";
+        }
+    } else if (command == "tag") {
+        VersionControlSystem vcs = openRepository(repoPath);
+        if (args.size() == 2 && args[0] == "--delete") {
+            vcs.untag(args[1]);
+        } else if (args.size() == 2) {
+            vcs.tag(std::stoi(args[0]), args[1]);
+        } else if (!args.empty()) {
+            throw std::invalid_argument("tag takes a version and a name, or --delete and a name");
+        }
+        out << "{\"command\":\"tag\",\"tags\":{";
+        bool first = true;
+        for (const auto& [name, version] : vcs.tags()) {
+            out << (first ? "" : ",") << quote(name) << ":" << version;
+            first = false;
+        }
+        out << "}}";
+    } else if (command == "gc") {
+        RetentionPolicy policy;
+        for (size_t i = 0; i < args.size(); i += 2) {
+            if (i + 1 >= args.size()) throw std::invalid_argument(args[i] + " needs a value");
+            if (args[i] == "--keep-last") {
+                policy.keepLast = std::stoi(args[i + 1]);
+            } else if (args[i] == "--keep-since") {
+                policy.keepSinceNs = parseTime(args[i + 1]);
+            } else {
+                throw std::invalid_argument("gc takes only --keep-last and --keep-since");
+            }
+        }
+        VersionControlSystem vcs = openRepository(repoPath);
+        // Round by round, as the GUI does, so the totals match what it would report
+        GarbageReport total;
+        int rounds = 0;
+        for (bool finished = false; !finished; rounds++) {
+            GarbageReport report = vcs.collectGarbage(policy);
+            total.versionsRemoved.insert(total.versionsRemoved.end(), report.versionsRemoved.begin(),
+                                         report.versionsRemoved.end());
+            total.objectsRemoved += report.objectsRemoved;
+            total.bytesReclaimed += report.bytesReclaimed;
+            total.objectsPacked += report.objectsPacked;
+            total.packsWritten += report.packsWritten;
+            total.packsRemoved += report.packsRemoved;
+            finished = report.finished;
+        }
+        out << "{\"command\":\"gc\",\"versions_removed\":[";
+        for (size_t i = 0; i < total.versionsRemoved.size(); i++) {
+            out << (i ? "," : "") << total.versionsRemoved[i];
+        }
+        out << "],\"objects_removed\":" << total.objectsRemoved << ",\"bytes_reclaimed\":" << total.bytesReclaimed
+            << ",\"objects_packed\":" << total.objectsPacked << ",\"packs_written\":" << total.packsWritten
+            << ",\"packs_removed\":" << total.packsRemoved << ",\"rounds\":" << rounds << "}";
+    } else {
+        throw std::invalid_argument("Unknown command: " + command);
+    }
+}
+
+}
+
+// Usage: mvcsApp [options] <command> [arguments...]
+// Results are printed to stdout as one JSON object per run, and messages to stderr.
+// Exit status: 0 on success, 1 when the command failed, 2 for invalid usage.
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string repoPath = ".", tracePath;
+    bool metrics = false;
+    while (!args.empty() && args[0].rfind("--", 0) == 0 && args[0] != "--help") {
+        if ((args[0] == "--repo" || args[0] == "--trace") && args.size() >= 2) {
+            (args[0] == "--repo" ? repoPath : tracePath) = args[1];
+            args.erase(args.begin());
+        } else if (args[0] == "--quiet") {
+            Trace::setVerbose(false);
+        } else if (args[0] == "--metrics") {
+            metrics = true;
+        } else {
+            std::cerr << "Unknown option: " << args[0] << "\n" << USAGE;
+            return 2;
+        }
+        args.erase(args.begin());
+    }
+    if (args.empty() || args[0] == "--help" || args[0] == "-h") {
+        std::cerr << USAGE;
+        return args.empty() ? 2 : 0;
+    }
+    std::string command = args[0];
+    args.erase(args.begin());
+    repoPath = absolutePath(repoPath);
+
+    // The library reports as it goes on std::cout, which would mix with the result
+    std::ostream out(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+    Trace::enableMetrics(metrics);
+    if (!tracePath.empty()) {
+        Trace::startTrace(tracePath);
+    }
+    int status = 0;
+    try {
+        std::ostringstream result;
+        runCommand(command, repoPath, args, result);
+        std::string json = result.str();
+        if (metrics) {
+            json.insert(json.size() - 1, ",\"metrics\":" + metricsJson());
+        }
+        out << json << std::endl;
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n" << USAGE;
+        status = 2;
+    } catch (const std::exception& e) {
+        out << "{\"command\":" << quote(command) << ",\"error\":" << quote(e.what()) << "}" << std::endl;
+        status = 1;
+    }
+    Trace::stopTrace();
+    std::cout.rdbuf(out.rdbuf());
+    return status;
+}
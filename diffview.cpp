@@ -0,0 +1,73 @@
+#include "diffview.h"
+#include <QFontDatabase>
+#include <QPlainTextEdit>
+#include <QSyntaxHighlighter>
+#include <QVBoxLayout>
+
+namespace {
+
+// Very large diffs are cut short; the view would take longer to lay them out than they take to read
+const int MAX_LINES = 100000;
+
+// Colours lines by their first character
+class DiffHighlighter : public QSyntaxHighlighter
+{
+public:
+    explicit DiffHighlighter(QTextDocument *document) : QSyntaxHighlighter(document)
+    {
+        removed.setForeground(QColor(0xc0, 0x20, 0x20));
+        added.setForeground(QColor(0x20, 0x90, 0x20));
+        hunk.setForeground(QColor(0x30, 0x60, 0xc0));
+        header.setFontWeight(QFont::Bold);
+    }
+
+protected:
+    void highlightBlock(const QString &line) override
+    {
+        if (line.startsWith("---") || line.startsWith("+++")) {
+            setFormat(0, line.size(), header);
+        } else if (line.startsWith('-')) {
+            setFormat(0, line.size(), removed);
+        } else if (line.startsWith('+')) {
+            setFormat(0, line.size(), added);
+        } else if (line.startsWith("@@")) {
+            setFormat(0, line.size(), hunk);
+        }
+    }
+
+private:
+    QTextCharFormat removed, added, hunk, header;
+};
+
+}
+
+// Constructor
+DiffView::DiffView(QWidget *parent)
+    : QDialog(parent)
+{
+    text = new QPlainTextEdit(this);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    new DiffHighlighter(text->document());
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(text);
+    resize(800, 600);
+}
+
+void DiffView::setDiffs(const QString &title, const std::vector<FileDiff> &diffs)
+{
+    setWindowTitle(title);
+    QStringList lines;
+    for (const FileDiff &diff : diffs) {
+        if (lines.size() >= MAX_LINES) {
+            lines << tr("... %1 more files").arg(diffs.size() - (&diff - diffs.data()));
+            break;
+        }
+        lines << QString::fromStdString(Diff::unified(diff)).split('\n', Qt::SkipEmptyParts);
+    }
+    if (diffs.empty()) {
+        lines << tr("No changes.");
+    }
+    text->setPlainText(lines.join('\n'));
+}
@@ -0,0 +1,24 @@
+#ifndef DIFFVIEW_H
+#define DIFFVIEW_H
+
+#include <QDialog>
+#include <vector>
+#include "CLICode/Diff.h"
+
+class QPlainTextEdit;
+
+// Window showing the changed lines of files as a unified diff, removed lines in red
+// and added ones in green
+class DiffView : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiffView(QWidget *parent = nullptr);
+    void setDiffs(const QString &title, const std::vector<FileDiff> &diffs);
+
+private:
+    QPlainTextEdit *text;
+};
+
+#endif // DIFFVIEW_H
@@ -0,0 +1,63 @@
+#include "fileview.h"
+#include <algorithm>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace {
+
+// Only the start of a large file is shown; Save As writes all of it
+const size_t MAX_SHOWN = 4 * 1024 * 1024;
+
+}
+
+// Constructor
+FileView::FileView(std::shared_ptr<Snapshot> snapshot, const std::string &path, QWidget *parent)
+    : QDialog(parent), snapshot(std::move(snapshot)), path(path)
+{
+    QString name = QFileInfo(QString::fromStdString(path)).fileName();
+    setWindowTitle(tr("%1 in version %2").arg(name).arg(this->snapshot->version()));
+    text = new QPlainTextEdit(this);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    uint64_t size = this->snapshot->size(path);
+    std::string content(static_cast<size_t>(std::min<uint64_t>(size, MAX_SHOWN)), '\0');
+    content.resize(this->snapshot->read(path, 0, &content[0], content.size()));
+    if (content.find('\0') != std::string::npos) {
+        text->setPlainText(tr("Binary file, %1 bytes.").arg(size));
+    } else {
+        QString shown = QString::fromStdString(content);
+        if (size > content.size()) {
+            shown += tr("\n... %1 more bytes").arg(size - content.size());
+        }
+        text->setPlainText(shown);
+    }
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton *save = buttons->addButton(tr("Save As..."), QDialogButtonBox::ActionRole);
+    connect(save, &QPushButton::clicked, this, &FileView::saveAs);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::close);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(text);
+    layout->addWidget(buttons);
+    resize(800, 600);
+}
+
+void FileView::saveAs()
+{
+    QString name = QFileInfo(QString::fromStdString(path)).fileName();
+    QString destPath = QFileDialog::getSaveFileName(this, tr("Save Version"), name);
+    if (destPath.isEmpty()) return;
+    try {
+        snapshot->extract(path, destPath.toStdString());
+    } catch (const std::exception& e) {
+        QMessageBox::information(this, tr("Save Error"), e.what());
+    }
+}
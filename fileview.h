@@ -0,0 +1,28 @@
+#ifndef FILEVIEW_H
+#define FILEVIEW_H
+
+#include <QDialog>
+#include <memory>
+#include "CLICode/Snapshot.h"
+
+class QPlainTextEdit;
+
+// Window showing a file as it was in a committed version, read from history without
+// touching the working copy, with a button to save it elsewhere
+class FileView : public QDialog
+{
+    Q_OBJECT
+
+public:
+    FileView(std::shared_ptr<Snapshot> snapshot, const std::string &path, QWidget *parent = nullptr);
+
+private slots:
+    void saveAs();
+
+private:
+    std::shared_ptr<Snapshot> snapshot;
+    std::string path;
+    QPlainTextEdit *text;
+};
+
+#endif // FILEVIEW_H
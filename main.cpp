@@ -1,12 +1,20 @@
 #include "mainwindow.h"
+#include "CLICode/Trace.h"
 
 #include <QApplication>
 
 #include <QFile>
+#include <cstdlib>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // ZIM_VCS_TRACE=<file> records a trace of the session's operations, written on exit
+    const char* tracePath = std::getenv("ZIM_VCS_TRACE");
+    if (tracePath && *tracePath) {
+        Trace::startTrace(tracePath);
+    }
     MainWindow w;
 
     // Set the app style sheet
@@ -16,5 +24,7 @@ int main(int argc, char *argv[])
     a.setStyleSheet(styleSheet);
 
     w.show();
-    return a.exec();
+    int result = a.exec();
+    Trace::stopTrace();
+    return result;
 }
@@ -3,10 +3,14 @@
 #include "QFileDialog"
 #include "QFileInfo"
 #include "QMessageBox"
+#include "QHeaderView"
+#include "QInputDialog"
 #include "CLICode/VersionControlSystem.h"
 #include <filesystem>
 #include <iostream>
 #include "CLICode/AuthenticationSystem.h"
+#include "diffview.h"
+#include "fileview.h"
 
 // Constructor for MainWindow class
 MainWindow::MainWindow(QWidget *parent)
@@ -18,14 +22,27 @@ MainWindow::MainWindow(QWidget *parent)
     repos = ui->reposList; // List of repositories
     tabs = ui->tabWidget;   // Tabs in the UI
     files = ui->statusList;  // List showing file status
+    statusModel = new StatusModel(this);
+    files->setModel(statusModel);
+    files->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed); // Rows are never measured one by one
+    files->setToolTip(tr("Double-click a file to see its changes since the last commit, "
+                         "or since the version entered next to Rollback"));
     QCoreApplication::setApplicationName( QString("ZIM Version Control System") );
     setWindowTitle( QCoreApplication::applicationName() );  // Set window title
+    setBusy(false);
+
+    // Changes come in bursts (an editor saving, a build), so refresh once they settle
+    liveRefresh = new QTimer(this);
+    liveRefresh->setSingleShot(true);
+    liveRefresh->setInterval(500);
+    connect(liveRefresh, &QTimer::timeout, this, &MainWindow::refreshChanged);
 
 }
 
 // Destructor for MainWindow class
 MainWindow::~MainWindow()
 {
+    job.reset(); // Cancel and wait for a running operation before the widgets go away
     delete ui;
 }
 
@@ -37,8 +54,9 @@ void MainWindow::on_initBtn_clicked()
     if (folderPath.isEmpty()) {
         displayError("No Folder has been selected");
     } else {
-        VersionControlSystem fileVcs(folderPath.toStdString());
-        fileVcs.init();
+        repositories.forget(folderPath.toStdString());
+        RepositoryCache::Session fileVcs = repositories.open(folderPath.toStdString());
+        fileVcs->init();
         repos->addItem(new QListWidgetItem(folderPath));
     }
 }
@@ -53,17 +71,25 @@ void MainWindow::on_removeRepoBtn_clicked()
     } else {
         QDir dir(dirPath);
 
-        // Prepare file paths for version_control.csv and version.txt
+        // Prepare file paths for the record index and version.txt
+        QString indexPath = dir.filePath("version_control.idx");
         QString versionControlPath = dir.filePath("version_control.csv");
         QString versionPath = dir.filePath("version.txt");
+        QString digestPath = dir.filePath("digest.txt");
         QString historyPath = dir.filePath("history");  // History is a directory
 
         // Check if the repository files exist
-        if (QFile::exists(versionControlPath)) {
+        if (Repository::isRepository(dirPath.toStdString())) {
             bool removed = true;
 
-            // Remove version_control.csv
-            if (!QFile::remove(versionControlPath)) {
+            // Remove version_control.idx
+            if (QFile::exists(indexPath) && !QFile::remove(indexPath)) {
+                displayError("Error removing version_control.idx");
+                removed = false;
+            }
+
+            // Remove version_control.csv, left by repositories never opened by this version
+            if (QFile::exists(versionControlPath) && !QFile::remove(versionControlPath)) {
                 displayError("Error removing version_control.csv");
                 removed = false;
             }
@@ -74,17 +100,25 @@ void MainWindow::on_removeRepoBtn_clicked()
                 removed = false;
             }
 
+            // Remove digest.txt, absent in repositories that were never opened by this version
+            if (QFile::exists(digestPath) && !QFile::remove(digestPath)) {
+                displayError("Error removing digest.txt");
+                removed = false;
+            }
+
             // Remove the history directory
             if (QDir(historyPath).exists()) {
                 QDir historyDir(historyPath);
                 historyDir.removeRecursively();  // Remove all contents and the directory itself
             }
 
+            repositories.forget(dirPath.toStdString());
+
             // If all items removed successfully, update the UI accordingly
             if (removed) {
                 delete repos->currentItem();
                 ui->repoName->setText("No Repository Selected");
-                ui->statusList->setRowCount(0);
+                statusModel->clear();
             }
 
         } else {
@@ -120,16 +154,21 @@ void MainWindow::on_addBtn_clicked()
             if (filenames.isEmpty()) {
                 displayError("No files have been selected");
             } else {
-                VersionControlSystem fileVcs(baseFolderPath.toStdString());
-                QStringList reservedNames = { "version_control.csv", "version.txt", "history" };
-
+                QStringList added;
+                std::vector<std::string> paths;
                 for (const QString &filename : filenames) {
                     // Skip if the file is a reserved name
-                    if (reservedNames.contains(QFileInfo(filename).fileName())) continue;
+                    if (Repository::isReservedName(QFileInfo(filename).fileName().toStdString())) continue;
 
-                    fileVcs.add(filename.toStdString());
-                    addFileToStatusList(baseFolderPath, filename);
+                    added << filename;
+                    paths.push_back(filename.toStdString());
                 }
+                runJob(tr("Adding files"), [paths](VersionControlSystem &fileVcs) { fileVcs.addMany(paths); },
+                       [this, baseFolderPath, added]() {
+                           for (const QString &filename : added) {
+                               addFileToStatusList(baseFolderPath, filename);
+                           }
+                       });
             }
         } else {
             throw std::runtime_error("No Repository to add files from.");
@@ -152,14 +191,14 @@ void MainWindow::on_addFolderBtn_clicked()
             } else {
                 QString dirNameOnly = QFileInfo(directoryName).fileName();
                 // Skip if the directory is reserved
-                if (dirNameOnly == "history") {
+                if (Repository::isReservedName(dirNameOnly.toStdString())) {
                     displayError("Reserved directory cannot be added");
                     return;
                 }
 
-                VersionControlSystem fileVcs(baseFolderPath.toStdString());
-                fileVcs.addDirectory(directoryName.toStdString());
-                addFileToStatusList(baseFolderPath, directoryName);
+                std::string foldername = directoryName.toStdString();
+                runJob(tr("Adding folder"), [foldername](VersionControlSystem &fileVcs) { fileVcs.addDirectory(foldername); },
+                       [this, baseFolderPath, directoryName]() { addFileToStatusList(baseFolderPath, directoryName); });
             }
         } else {
             throw std::runtime_error("No Repository to add files from.");
@@ -177,22 +216,25 @@ void MainWindow::on_addAllBtn_clicked()
         if (QListWidgetItem *currentItem = repos->currentItem()) {
             QString baseFolderPath = getCurrentRepo();
             QDir baseFolderDir(baseFolderPath);
-            VersionControlSystem fileVcs(baseFolderPath.toStdString());
-            QStringList reservedNames = { "version_control.csv", "version.txt", "history" };
 
             QFileInfoList entries = baseFolderDir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+            QStringList added;
+            std::vector<std::string> paths;
             for (const QFileInfo &entry : entries) {
-                QString path = entry.absoluteFilePath();
                 // Skip if the item is reserved
-                if (reservedNames.contains(entry.fileName())) continue;
+                if (Repository::isReservedName(entry.fileName().toStdString())) continue;
 
-                if (entry.isDir()) {
-                    fileVcs.addDirectory(path.toStdString());
-                } else if (entry.isFile()) {
-                    fileVcs.add(path.toStdString());
+                if (entry.isDir() || entry.isFile()) {
+                    added << entry.absoluteFilePath();
+                    paths.push_back(entry.absoluteFilePath().toStdString());
                 }
-                addFileToStatusList(baseFolderPath, path);
             }
+            runJob(tr("Adding all"), [paths](VersionControlSystem &fileVcs) { fileVcs.addMany(paths); },
+                   [this, baseFolderPath, added]() {
+                       for (const QString &path : added) {
+                           addFileToStatusList(baseFolderPath, path);
+                       }
+                   });
 
         } else {
             throw std::runtime_error("No Repository to add files from.");
@@ -208,19 +250,17 @@ void MainWindow::on_removeFileBtn_clicked()
 {
     try{
         if (QListWidgetItem *currentRepo = repos->currentItem()){
-            QTableWidgetItem *currentItem = files->currentItem();
+            QModelIndex currentIndex = files->currentIndex();
 
-            if (currentItem) {
-                int row = currentItem->row();
+            if (currentIndex.isValid()) {
                 QString baseFolderPath = getCurrentRepo();
-
-                QString filename = files->item(row, 0)->text();
-
-                QString filePath = baseFolderPath + '/' + filename;
-                // Call Repository's untrackFile method to untrack the file
-                Repository repo = Repository(baseFolderPath.toStdString());
-                repo.untrackFile(filePath.toStdString());
-                files->removeRow(row); // Remove the row from the table
+                std::string filePath = statusModel->pathAt(currentIndex.row());
+                // Untrack the file in the cached repository
+                {
+                    RepositoryCache::Session fileVcs = repositories.open(baseFolderPath.toStdString());
+                    fileVcs->remove(filePath);
+                }
+                updateStatusList(); // Drops the row
             } else {
                 displayError("No item selected to remove.");
             }
@@ -237,10 +277,12 @@ void MainWindow::on_commitBtn_clicked()
 {
     try{
         if (QListWidgetItem *currentItem = repos->currentItem()){
-            QString baseFolderPath = getCurrentRepo();
-            VersionControlSystem fileVcs(baseFolderPath.toStdString());
-            fileVcs.commit();
-            updateRepoSelection(repos->currentItem());
+            runJob(tr("Committing"),
+                   [author = user](VersionControlSystem &fileVcs) {
+                       fileVcs.setAuthor(author);
+                       fileVcs.commit();
+                   },
+                   [this]() { updateRepoSelection(repos->currentItem()); });
         } else {
             throw std::runtime_error("No Repository to add files from.");
         }
@@ -256,10 +298,10 @@ void MainWindow::on_openBtn_clicked()
 
     if (folderPath.isEmpty()) {
         displayError("No Folder has been selected");
-    } else if (! std::filesystem::exists(folderPath.toStdString() + "/version_control.csv")) {
+    } else if (!Repository::isRepository(folderPath.toStdString())) {
         displayError("This folder is not a repository");
     } else {
-        VersionControlSystem fileVcs(folderPath.toStdString());
+        repositories.open(folderPath.toStdString()); // Loaded now, reused when selected
         repos->addItem(new QListWidgetItem(folderPath));
     }
 }
@@ -270,10 +312,8 @@ void MainWindow::on_refreshBtn_clicked()
 
     try{
         if (QListWidgetItem *currentItem = repos->currentItem()){
-            QString baseFolderPath = getCurrentRepo();
-            VersionControlSystem fileVcs(baseFolderPath.toStdString());
-            fileVcs.refresh();
-            updateStatusList();
+            runJob(tr("Refreshing"), [](VersionControlSystem &fileVcs) { fileVcs.refresh(); },
+                   [this]() { updateStatusList(); });
         } else {
             throw std::runtime_error("No Repository to add files from.");
         }
@@ -285,7 +325,7 @@ void MainWindow::on_refreshBtn_clicked()
 
 void MainWindow::on_signin_clicked()
 {
-    AuthenticationSystem auth;
+    AuthenticationSystem auth((QCoreApplication::applicationDirPath() + "/users.csv").toStdString());
 
 
 
@@ -295,6 +335,7 @@ void MainWindow::on_signin_clicked()
     pass = ui->password->text();
 
     if (auth.authenticateUser(user.toStdString(), pass.toStdString())) {
+        this->user = user.toStdString();
         ui->stackedWidget->setCurrentWidget(ui->repoPage);
     } else {
         displayError("Wrong Credentials.");
@@ -307,10 +348,9 @@ void MainWindow::on_rollbackBtn_clicked()
 {
     try{
         if (QListWidgetItem *currentItem = repos->currentItem()){
-            QString baseFolderPath = getCurrentRepo();
-            VersionControlSystem fileVcs(baseFolderPath.toStdString());
-            fileVcs.rollback(ui->rollback->text().toInt());
-            updateRepoSelection(currentItem);
+            int version = ui->rollback->text().toInt();
+            runJob(tr("Rolling back"), [version](VersionControlSystem &fileVcs) { fileVcs.rollback(version); },
+                   [this, currentItem]() { updateRepoSelection(currentItem); });
         } else {
             throw std::runtime_error("No Repository to rollback from.");
         }
@@ -320,6 +360,104 @@ void MainWindow::on_rollbackBtn_clicked()
 }
 
 
+void MainWindow::on_cancelBtn_clicked()
+{
+    if (job) {
+        job->cancel();
+        ui->cancelBtn->setEnabled(false);
+    }
+}
+
+
+// Show the changes of a file or folder since the last commit, or since the version in the rollback field
+void MainWindow::on_statusList_doubleClicked(const QModelIndex &index)
+{
+    try {
+        if (!index.isValid()) return;
+        std::string path = statusModel->pathAt(index.row());
+        bool isNumber = false;
+        int version = ui->rollback->text().toInt(&isNumber);
+        if (!isNumber) {
+            RepositoryCache::Session fileVcs = repositories.open(getCurrentRepo().toStdString());
+            version = fileVcs->getVersion() - 1;
+        }
+        if (version < 0) {
+            throw std::runtime_error("Nothing has been committed yet.");
+        }
+        auto diffs = std::make_shared<std::vector<FileDiff>>();
+        QString title = tr("%1 since version %2").arg(QFileInfo(QString::fromStdString(path)).fileName()).arg(version);
+        runJob(tr("Comparing"),
+               [diffs, version, path](VersionControlSystem &fileVcs) {
+                   *diffs = fileVcs.diff(version, Repository::WORKING_FILES, {path});
+               },
+               [this, diffs, title]() {
+                   DiffView *view = new DiffView(this);
+                   view->setAttribute(Qt::WA_DeleteOnClose);
+                   view->setDiffs(title, *diffs);
+                   view->show();
+               });
+    } catch (const std::exception& e) {
+        displayError(e.what());
+    }
+}
+
+
+// Show the selected file as it was in the version in the rollback field, or in the last commit,
+// without touching the working copy
+void MainWindow::on_viewBtn_clicked()
+{
+    try {
+        QModelIndex index = files->currentIndex();
+        if (!index.isValid()) {
+            throw std::runtime_error("No file selected.");
+        }
+        std::string path = statusModel->pathAt(index.row());
+        std::shared_ptr<Snapshot> snapshot;
+        {
+            RepositoryCache::Session fileVcs = repositories.open(getCurrentRepo().toStdString());
+            bool isNumber = false;
+            int version = ui->rollback->text().toInt(&isNumber);
+            if (!isNumber) {
+                version = fileVcs->getVersion() - 1;
+            }
+            if (version < 0) {
+                throw std::runtime_error("Nothing has been committed yet.");
+            }
+            snapshot = std::make_shared<Snapshot>(fileVcs->open(version));
+        }
+        if (!snapshot->contains(path)) {
+            throw std::runtime_error("Version " + std::to_string(snapshot->version()) + " has no file " + path);
+        }
+        FileView *view = new FileView(snapshot, path, this);
+        view->setAttribute(Qt::WA_DeleteOnClose);
+        view->show();
+    } catch (const std::exception& e) {
+        displayError(e.what());
+    }
+}
+
+
+// Drop all but the last versions asked for, tagged ones and the latest always kept, and
+// reclaim the space of what they alone used
+void MainWindow::on_cleanBtn_clicked()
+{
+    try {
+        if (!repos->currentItem()) {
+            throw std::runtime_error("No Repository to clean up.");
+        }
+        bool ok = false;
+        int keep = QInputDialog::getInt(this, tr("Clean Up"),
+                                        tr("Versions to keep (tagged versions are always kept):"), 10, 1, 1000000, 1, &ok);
+        if (!ok) return;
+        RetentionPolicy policy;
+        policy.keepLast = keep;
+        collectGarbage(getCurrentRepo(), policy, std::make_shared<GarbageReport>());
+    } catch (const std::exception& e) {
+        displayError(e.what());
+    }
+}
+
+
 // Utility Functions
 void MainWindow::displayError(const QString &message) {
     QMessageBox::information(this, tr("Selection Error"), message);
@@ -333,35 +471,171 @@ void MainWindow::updateRepoSelection(QListWidgetItem *currentItem) {
     QString fullPath = currentItem->text();
     QFileInfo fileInfo(fullPath);
     QString lastPart = fileInfo.fileName();
-    VersionControlSystem vcs(fullPath.toStdString());
-    ui->repoName->setText(lastPart + " : Version " + QString::number(vcs.getVersion()));
+    int version;
+    // Through the cache, so the repository is watched again whenever it is reloaded
+    repositories.watch(fullPath.toStdString(), [this]() {
+        QMetaObject::invokeMethod(liveRefresh, [this]() { liveRefresh->start(); }, Qt::QueuedConnection);
+    });
+    {
+        RepositoryCache::Session vcs = repositories.open(fullPath.toStdString());
+        version = vcs->getVersion();
+    }
+    ui->repoName->setText(lastPart + " : Version " + QString::number(version));
     updateStatusList();
 }
 
+// Bring the status table in line with the records; only rows that differ are updated
 void MainWindow::updateStatusList() {
-    files->setRowCount(0);
     QString baseFolderPath = getCurrentRepo();
     QDir baseFolder(baseFolderPath);
-    VersionControlSystem fileVcs(baseFolderPath.toStdString());
-    std::vector<std::string> fileNames = fileVcs.getFiles();
-    std::cout << fileNames.size() << std::endl;
-    std::vector<bool> status = fileVcs.status();
-    for (int i = 0; i < fileNames.size(); i++) {
-        int row = files->rowCount();
-        files->insertRow(row);
-        files->setItem(row, 0, new QTableWidgetItem(baseFolder.relativeFilePath(QString::fromStdString(fileNames[i]))));
-        files->setItem(row, 1, new QTableWidgetItem((status[i])?"Modified":"Up to Date"));
+    std::vector<StatusModel::Entry> entries;
+    {
+        RepositoryCache::Session fileVcs = repositories.open(baseFolderPath.toStdString());
+        std::vector<std::string> fileNames = fileVcs->getFiles();
+        std::vector<bool> status = fileVcs->status();
+        entries.reserve(fileNames.size());
+        for (size_t i = 0; i < fileNames.size(); i++) {
+            StatusModel::Entry entry{fileNames[i], status[i] ? StatusModel::Modified : StatusModel::UpToDate, {}};
+            if (status[i] && QFileInfo(QString::fromStdString(fileNames[i])).isDir()) {
+                // List the changed files of a modified folder
+                for (const std::string& filename : fileVcs->modifiedFiles(fileNames[i])) {
+                    entry.changedFiles << baseFolder.relativeFilePath(QString::fromStdString(filename));
+                }
+            }
+            entries.push_back(std::move(entry));
+        }
     }
+    statusModel->setBaseFolder(baseFolderPath);
+    statusModel->update(entries);
 }
 
 void MainWindow::addFileToStatusList(const QString &baseFolderPath, const QString &filename) {
-    QDir baseFolder(baseFolderPath);
-    QString relativePath = baseFolder.relativeFilePath(filename);
+    statusModel->setBaseFolder(baseFolderPath);
+    statusModel->addNew(filename.toStdString());
+}
+
+
+
+// Run a repository operation on a background thread, on the cached VersionControlSystem
+// of the current repository. Progress and the result come back on the GUI thread;
+// `done` runs there once the operation succeeded.
+void MainWindow::runJob(const QString &title, std::function<void(VersionControlSystem&)> operation, std::function<void()> done)
+{
+    if (job) {
+        throw std::runtime_error("Another operation is still running.");
+    }
+    std::string repoPath = getCurrentRepo().toStdString();
+    jobTitle = title;
+    setBusy(true);
+
+    Job::Listener listener;
+    listener.progress = [this](const Progress::Snapshot &snapshot) {
+        QMetaObject::invokeMethod(this, [this, snapshot]() { showProgress(snapshot); }, Qt::QueuedConnection);
+    };
+    listener.finished = [this, done](const std::string &error, bool cancelled) {
+        QString message = QString::fromStdString(error);
+        QMetaObject::invokeMethod(this, [this, message, cancelled, done]() { finishJob(message, cancelled, done); },
+                                  Qt::QueuedConnection);
+    };
+    job = std::make_unique<Job>([this, repoPath, operation](Progress &progress) {
+        RepositoryCache::Session fileVcs = repositories.open(repoPath);
+        fileVcs->setProgress(&progress);
+        operation(*fileVcs); // On failure the session drops the repository, progress included
+        fileVcs->setProgress(nullptr);
+    }, listener);
+}
+
+void MainWindow::showProgress(const Progress::Snapshot &snapshot) {
+    if (!job) return; // Reported after the job finished
+    double fraction = 0;
+    if (snapshot.bytesTotal > 0) {
+        fraction = static_cast<double>(snapshot.bytesDone) / snapshot.bytesTotal;
+    } else if (snapshot.filesTotal > 0) {
+        fraction = static_cast<double>(snapshot.filesDone) / snapshot.filesTotal;
+    }
+    QString text = tr("%1: %2 of %3 files").arg(jobTitle).arg(snapshot.filesDone).arg(snapshot.filesTotal);
+    if (snapshot.bytesTotal > 0) {
+        text += tr(", %1 of %2 MB").arg(snapshot.bytesDone / 1e6, 0, 'f', 1).arg(snapshot.bytesTotal / 1e6, 0, 'f', 1);
+    }
+    if (snapshot.remainingSeconds >= 0) {
+        text += tr(", %1 s left").arg(static_cast<long long>(snapshot.remainingSeconds + 0.5));
+    }
+    ui->progressBar->setValue(static_cast<int>(fraction * ui->progressBar->maximum()));
+    ui->progressBar->setFormat(text);
+}
+
+void MainWindow::finishJob(const QString &error, bool cancelled, const std::function<void()> &done) {
+    job.reset(); // Its thread has already reported, this only joins it
+    setBusy(false);
+    try {
+        if (cancelled) {
+            displayError(jobTitle + tr(" cancelled."));
+        } else if (!error.isEmpty()) {
+            displayError(error);
+        } else if (done) {
+            done();
+        }
+    } catch (const std::exception& e) {
+        displayError(e.what());
+    }
+}
 
-    int row = files->rowCount();
-    files->insertRow(row);
-    files->setItem(row, 0, new QTableWidgetItem(relativePath));
-    files->setItem(row, 1, new QTableWidgetItem("New"));
+// Refresh the selected repository after files changed under it; only the changed files are hashed
+void MainWindow::refreshChanged() {
+    if (job) {
+        liveRefresh->start(); // Try again once the running operation is done
+        return;
+    }
+    if (repos->currentItem()) {
+        runJob(tr("Refreshing"), [](VersionControlSystem &fileVcs) { fileVcs.refresh(); }, [this]() { updateStatusList(); });
+    }
 }
 
+// One bounded round of garbage collection per job; the next round waits behind whatever else
+// was started meanwhile, so cleaning up a large history never holds the repository for long.
+// Rounds stop once another repository is selected.
+void MainWindow::collectGarbage(const QString &repo, RetentionPolicy policy, std::shared_ptr<GarbageReport> total) {
+    if (!repos->currentItem() || repos->currentItem()->text() != repo) {
+        return;
+    }
+    if (job) {
+        QTimer::singleShot(100, this, [this, repo, policy, total]() { collectGarbage(repo, policy, total); });
+        return;
+    }
+    auto round = std::make_shared<GarbageReport>();
+    try {
+        runJob(tr("Cleaning up"),
+               [policy, round](VersionControlSystem &fileVcs) { *round = fileVcs.collectGarbage(policy); },
+               [this, repo, policy, total, round]() {
+                   total->versionsRemoved += round->versionsRemoved;
+                   total->objectsRemoved += round->objectsRemoved;
+                   total->bytesReclaimed += round->bytesReclaimed;
+                   if (!round->finished) {
+                       QTimer::singleShot(0, this, [this, repo, policy, total]() { collectGarbage(repo, policy, total); });
+                       return;
+                   }
+                   updateRepoSelection(repos->currentItem());
+                   QMessageBox::information(this, tr("Clean Up"),
+                                            tr("Removed %1 versions and %2 objects, reclaimed %3 MB.")
+                                                .arg(total->versionsRemoved).arg(total->objectsRemoved)
+                                                .arg(total->bytesReclaimed / 1e6, 0, 'f', 1));
+               });
+    } catch (const std::exception& e) {
+        displayError(e.what());
+    }
+}
 
+// While an operation runs, only it may use the repository, so everything but Cancel is disabled
+void MainWindow::setBusy(bool busy) {
+    const QList<QWidget *> controls = {repos, files, ui->initBtn, ui->removeRepoBtn, ui->selectBtn, ui->openBtn,
+                                       ui->addBtn, ui->addFolderBtn, ui->addAllBtn, ui->removeFileBtn, ui->commitBtn,
+                                       ui->refreshBtn, ui->rollbackBtn, ui->rollback, ui->viewBtn, ui->cleanBtn};
+    for (QWidget *widget : controls) {
+        widget->setEnabled(!busy);
+    }
+    ui->progressBar->setValue(0);
+    ui->progressBar->setFormat(jobTitle);
+    ui->progressBar->setVisible(busy);
+    ui->cancelBtn->setVisible(busy);
+    ui->cancelBtn->setEnabled(busy);
+}
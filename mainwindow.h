@@ -4,7 +4,13 @@
 #include <QMainWindow>
 #include <QListWidget>
 #include <QTabWidget>
-#include <QTableWidget>
+#include <QTableView>
+#include <QTimer>
+#include <functional>
+#include <memory>
+#include "CLICode/Job.h"
+#include "CLICode/RepositoryCache.h"
+#include "statusmodel.h"
 #include "CLICode/VersionControlSystem.h"
 
 QT_BEGIN_NAMESPACE
@@ -46,16 +52,36 @@ private slots:
 
     void on_rollbackBtn_clicked();
 
+    void on_cancelBtn_clicked();
+
+    void on_statusList_doubleClicked(const QModelIndex &index);
+
+    void on_viewBtn_clicked();
+
+    void on_cleanBtn_clicked();
+
 private:
     Ui::MainWindow *ui;
     QListWidget *repos;
     QTabWidget *tabs;
-    QTableWidget *files;
+    QTableView *files;
+    StatusModel *statusModel; // Rows of `files`
+    RepositoryCache repositories; // Loaded repositories, shared with the running job
+    std::unique_ptr<Job> job; // Repository operation running in the background, if any
+    QString jobTitle;
+    QTimer *liveRefresh; // Refreshes the statuses shortly after files change
+    std::string user; // Signed-in user, the author of commits
     void displayError(const QString &message);
     QString getCurrentRepo();
     void updateRepoSelection(QListWidgetItem *currentItem);
     void updateStatusList();
     void addFileToStatusList(const QString &baseFolderPath, const QString &filename);
+    void runJob(const QString &title, std::function<void(VersionControlSystem&)> operation, std::function<void()> done);
+    void showProgress(const Progress::Snapshot &snapshot);
+    void finishJob(const QString &error, bool cancelled, const std::function<void()> &done);
+    void setBusy(bool busy);
+    void refreshChanged();
+    void collectGarbage(const QString &repo, RetentionPolicy policy, std::shared_ptr<GarbageReport> total);
 
 };
 #endif // MAINWINDOW_H
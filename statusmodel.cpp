@@ -0,0 +1,145 @@
+#include "statusmodel.h"
+#include <QDir>
+#include <unordered_set>
+
+// Constructor
+StatusModel::StatusModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int StatusModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+int StatusModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant StatusModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) {
+        return QVariant();
+    }
+    const Row &row = rows[index.row()];
+    if (role == Qt::DisplayRole) {
+        if (index.column() == 0) {
+            return row.name;
+        }
+        switch (row.status) {
+        case Modified: return tr("Modified");
+        case New: return tr("New");
+        default: return tr("Up to Date");
+        }
+    }
+    if (role == Qt::ToolTipRole && !row.changedFiles.isEmpty()) {
+        return row.changedFiles.join("\n");
+    }
+    return QVariant();
+}
+
+QVariant StatusModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        return section == 0 ? tr("Files") : tr("Status");
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+void StatusModel::setBaseFolder(const QString &baseFolderPath)
+{
+    if (baseFolderPath != baseFolder) {
+        beginResetModel();
+        baseFolder = baseFolderPath;
+        rows.clear();
+        endResetModel();
+    }
+}
+
+StatusModel::Row StatusModel::rowOf(const Entry &entry) const
+{
+    // Records are absolute paths inside the repository, which only need their prefix cut
+    QString path = QString::fromStdString(entry.path);
+    QString prefix = baseFolder + '/';
+    QString name = path.startsWith(prefix) ? path.mid(prefix.size()) : QDir(baseFolder).relativeFilePath(path);
+    return {entry.path, name, entry.status, entry.changedFiles};
+}
+
+void StatusModel::reset(const std::vector<Entry> &entries)
+{
+    beginResetModel();
+    rows.clear();
+    rows.reserve(entries.size());
+    for (const Entry &entry : entries) {
+        rows.push_back(rowOf(entry));
+    }
+    endResetModel();
+}
+
+// Records keep their order: new ones are appended and untracked ones dropped. Both
+// lists are walked side by side, so unchanged rows cost a comparison and changed
+// rows one notification; anything reordered falls back to a full reset.
+void StatusModel::update(const std::vector<Entry> &entries)
+{
+    if (rows.empty()) {
+        reset(entries);
+        return;
+    }
+    std::unordered_set<std::string> oldPaths, newPaths;
+    for (const Row &row : rows) {
+        oldPaths.insert(row.path);
+    }
+    for (const Entry &entry : entries) {
+        newPaths.insert(entry.path);
+    }
+
+    size_t i = 0, j = 0;
+    while (i < rows.size() || j < entries.size()) {
+        int row = static_cast<int>(i);
+        if (i < rows.size() && j < entries.size() && rows[i].path == entries[j].path) {
+            if (rows[i].status != entries[j].status || rows[i].changedFiles != entries[j].changedFiles) {
+                rows[i].status = entries[j].status;
+                rows[i].changedFiles = entries[j].changedFiles;
+                emit dataChanged(index(row, 0), index(row, 1));
+            }
+            i++;
+            j++;
+        } else if (i < rows.size() && newPaths.count(rows[i].path) == 0) {
+            beginRemoveRows(QModelIndex(), row, row);
+            rows.erase(rows.begin() + i);
+            endRemoveRows();
+        } else if (j < entries.size() && oldPaths.count(entries[j].path) == 0) {
+            beginInsertRows(QModelIndex(), row, row);
+            rows.insert(rows.begin() + i, rowOf(entries[j]));
+            endInsertRows();
+            i++;
+            j++;
+        } else {
+            reset(entries);
+            return;
+        }
+    }
+}
+
+void StatusModel::addNew(const std::string &path)
+{
+    Entry entry{path, New, {}};
+    int row = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), row, row);
+    rows.push_back(rowOf(entry));
+    endInsertRows();
+}
+
+void StatusModel::clear()
+{
+    beginResetModel();
+    rows.clear();
+    endResetModel();
+}
+
+std::string StatusModel::pathAt(int row) const
+{
+    return rows.at(row).path;
+}
@@ -0,0 +1,54 @@
+#ifndef STATUSMODEL_H
+#define STATUSMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStringList>
+#include <string>
+#include <vector>
+
+// Tracked files of a repository with their status, for the status table. The view
+// only asks for the rows it shows, and updating from a new set of records only
+// touches the rows that were added, removed or changed status, so large
+// repositories stay cheap to display and refresh.
+class StatusModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Status { UpToDate, Modified, New };
+
+    // A record as read from the repository
+    struct Entry {
+        std::string path;
+        Status status = UpToDate;
+        QStringList changedFiles; // Files changed inside a modified folder
+    };
+
+    explicit StatusModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setBaseFolder(const QString &baseFolderPath); // Clears the rows when the repository changes
+    void update(const std::vector<Entry> &entries);
+    void addNew(const std::string &path); // Added, shown as New until the next update
+    void clear();
+    std::string pathAt(int row) const;
+
+private:
+    struct Row {
+        std::string path;
+        QString name; // Relative to the repository
+        Status status;
+        QStringList changedFiles;
+    };
+
+    QString baseFolder;
+    std::vector<Row> rows;
+    Row rowOf(const Entry &entry) const;
+    void reset(const std::vector<Entry> &entries);
+};
+
+#endif // STATUSMODEL_H
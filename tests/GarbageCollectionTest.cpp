@@ -0,0 +1,84 @@
+#include "Tests.h"
+#include "VersionControlSystem.h"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// About 100 KB of random text lines, large enough to be stored as blocks and deltas
+std::string randomText() {
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+/";
+    std::mt19937 random(42);
+    std::string text;
+    for (int line = 0; line < 1300; line++) {
+        for (int i = 0; i < 76; i++) {
+            text.push_back(letters[random() % 64]);
+        }
+        text.push_back('\n');
+    }
+    return text;
+}
+
+void collectAll(VersionControlSystem& vcs, const RetentionPolicy& policy) {
+    for (int round = 0; !vcs.collectGarbage(policy).finished; round++) {
+        check(round < 1000, "collectGarbage never finished");
+    }
+}
+
+}
+
+// Repacking chains a copied file onto the history of the file it was copied from; a later
+// collection dropping that history must keep whatever the packed copy is a delta of
+void testRepackThenCollect(const std::string& folder) {
+    std::vector<std::string> paths;
+    for (int i = 1; i <= 20; i++) {
+        paths.push_back(folder + "/s" + std::to_string(i) + ".txt");
+        writeFile(paths.back(), "small " + std::to_string(i) + "\n");
+    }
+    std::string original = folder + "/q.txt", copy = folder + "/p.txt";
+    std::string text = randomText();
+    writeFile(original, text);
+    paths.push_back(original);
+
+    VersionControlSystem vcs(folder);
+    vcs.init();
+    vcs.addMany(paths);
+    writeFile(paths[1], "small 2\ny\n");
+    vcs.commit();
+
+    text.replace(4 * 77, 76, std::string(76, '-'));
+    writeFile(original, text);
+    vcs.commit();
+
+    writeFile(copy, text);
+    vcs.add(copy);
+    writeFile(paths[0], "small 1\nx\n");
+    vcs.commit();
+    check(vcs.getVersion() == 3, "expected three versions");
+
+    collectAll(vcs, RetentionPolicy());
+    vcs.repack();
+    RetentionPolicy keepLast;
+    keepLast.keepLast = 1;
+    collectAll(vcs, keepLast);
+
+    writeFile(original, "junk\n");
+    vcs.rollback(2);
+    check(readFile(original) == text, "q.txt differs from version 2 after the rollback");
+    check(readFile(copy) == text, "p.txt differs from version 2 after the rollback");
+    check(readFile(paths[0]) == "small 1\nx\n", "s1.txt differs from version 2 after the rollback");
+}
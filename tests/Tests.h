@@ -0,0 +1,17 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdexcept>
+#include <string>
+
+// Fails the running test with `message` unless `condition` holds
+inline void check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+// Each test builds its repositories under `folder` and throws on failure
+void testRepackThenCollect(const std::string& folder);
+
+#endif // TESTS_H
@@ -0,0 +1,34 @@
+#include "Tests.h"
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// Usage: vcsTests [folder]
+int main(int argc, char *argv[])
+{
+    std::filesystem::path folder = argc > 1 ? std::filesystem::path(argv[1])
+                                            : std::filesystem::temp_directory_path() / "vcsTests";
+    struct Test {
+        const char* name;
+        void (*run)(const std::string&);
+    };
+    const std::vector<Test> tests = {
+        {"repack then collect", testRepackThenCollect},
+    };
+
+    int failures = 0;
+    for (const Test& test : tests) {
+        std::filesystem::path testFolder = folder / test.name;
+        std::filesystem::remove_all(testFolder);
+        std::filesystem::create_directories(testFolder);
+        try {
+            test.run(testFolder.string());
+            std::cerr << "PASS " << test.name << std::endl;
+            std::filesystem::remove_all(testFolder);
+        } catch (const std::exception& e) {
+            std::cerr << "FAIL " << test.name << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}